@@ -0,0 +1,323 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Graph/DhakaGraph.h"
+#include "../Graph/RouteQuery.h"
+#include "../Graph/WorkStealing.h"
+
+using namespace std;
+
+/*
+    Loads the graph once and answers a stream of route queries, one per
+    line (see RouteQuery.h for the format, blank lines and lines starting
+    with # are skipped):
+
+        1 90.363824 23.834127 90.375864 23.723166
+        4 90.363824 23.834127 90.375864 23.723166 05:43pm
+        6 90.363824 23.834127 90.375864 23.723166 6:45pm 8:40pm
+        distance 1 90.363824 23.834127 90.375864 23.723166
+        timetable 5 90.363824 23.834127 90.375864 23.723166 05:43pm
+        changes 5 90.363824 23.834127 90.375864 23.723166 05:43pm
+
+    and writes one CSV record per query, id being the query's line number.
+    A changes query gets one record per option under the same id, fewest
+    vehicles first.
+
+        cd "Batch Query"
+        g++ -O2 -pthread Batch-Query.cpp -o Batch-Query
+        ./Batch-Query [--check] queries.txt results.csv [threads]
+
+    Queries are read from stdin and results written to stdout when the
+    files are left out or given as "-".
+
+    The queries are answered on every hardware thread unless `threads`
+    says otherwise. Each thread has its own RouteSolver and steals queries
+    from the others when it runs out (WorkStealing.h), so a run of slow
+    Problem 6 queries does not hold up the rest. Records still come out in
+    input order: each query's slot is filled by the thread that answered
+    it, and the main thread writes the slots out as soon as they are ready.
+    Throughput and latency percentiles go to stderr.
+
+    --check also answers every changes query with connectionScan() and
+    checks the options against it: arrivals strictly earlier option by
+    option, none before the departure or after the scheduled time, the last
+    one the Connection Scan arrival. A query with a scheduled time (Problem
+    6) must arrive by it, and find a path whenever the earliest arrival
+    makes it. Disagreements go to stderr and the exit status is 1.
+    timetable-checks.txt has changes queries around and outside service
+    hours, deadline-checks.txt Problem 6 queries due just after their
+    earliest arrival:
+
+        ./Batch-Query --check timetable-checks.txt - > /dev/null
+        ./Batch-Query --check deadline-checks.txt - > /dev/null
+*/
+
+struct BatchQuery
+{
+    int lineNumber;
+    string line;
+    int problem = 0; // 0 when the line did not parse
+    double milliseconds = 0;
+    int settled = 0;
+    string record;
+    atomic<bool> done{false};
+};
+
+// What is wrong with the options of a changes query, empty when they agree with connectionScan()
+string checkOptions(RouteSolver &solver, RouteQuery request, const vector<RouteResult> &options)
+{
+    for (size_t i = 0; i < options.size(); i++)
+    {
+        if (options[i].arrival < options[i].departure || options[i].arrival > request.scheduledTime)
+            return "option " + to_string(i) + " arrives outside the departure and scheduled time";
+        if (i && options[i].arrival >= options[i - 1].arrival)
+            return "option " + to_string(i) + " arrives no earlier than the one before";
+    }
+
+    request.changes = false;
+    RouteResult scan = solver.solve(request);
+    if (scan.found != !options.empty())
+        return scan.found ? "no option, connection scan found a path" : "options, connection scan found no path";
+    if (scan.found && abs(scan.arrival - options.back().arrival) > 1e-6)
+        return "earliest option arrives at " + convertMinutesToTime(options.back().arrival) + ", connection scan at " +
+               convertMinutesToTime(scan.arrival);
+    return "";
+}
+
+/*
+    What is wrong with the answer of a query with a scheduled time, empty
+    when it is on time, or there is none and nothing makes the scheduled
+    time: the earliest arrival, searched for on `query` with the problem's
+    modes and no deadline, is what a path needs.
+*/
+string checkDeadline(QueryGraph &query, SearchContext &nodes, const RouteQuery &request, const RouteResult &result)
+{
+    if (result.found && result.arrival > request.scheduledTime + 1e-6)
+        return "arrives at " + convertMinutesToTime(result.arrival) + ", after the scheduled time";
+    if (result.found)
+        return "";
+
+    ProblemSpec fastest = problemSpec(request.problem);
+    fastest.objective = MIN_ARRIVAL;
+    query.clear();
+    int srcID = query.attach(request.src_lonLat, fastest.modes);
+    int dstID = query.attach(request.dst_lonLat, fastest.modes, srcID);
+    if (srcID == -1 || dstID == -1)
+        return "";
+
+    astar(fastest, srcID, dstID, nodes, query, request.startingTime);
+    if (nodes[dstID].cost == INT_MAX || nodes[dstID].arrivalTime > request.scheduledTime)
+        return "";
+    return "no path, yet the earliest arrival " + convertMinutesToTime(nodes[dstID].arrivalTime) + " makes the scheduled time";
+}
+
+// value below which `fraction` of the sorted latencies lie
+double percentile(const vector<double> &sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[min(sorted.size() - 1, (size_t)(fraction * sorted.size()))];
+}
+
+void reportLatency(const string &label, vector<double> latencies)
+{
+    if (latencies.empty())
+        return;
+
+    sort(latencies.begin(), latencies.end());
+    double sum = 0;
+    for (double ms : latencies)
+        sum += ms;
+
+    cerr << label << ": " << latencies.size() << " queries, ms mean " << sum / latencies.size() << ", p50 " << percentile(latencies, 0.5)
+         << ", p90 " << percentile(latencies, 0.9) << ", p99 " << percentile(latencies, 0.99) << ", max " << latencies.back() << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    bool check = false;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--check")
+            check = true;
+        else
+            args.push_back(argv[i]);
+    }
+
+    string inputPath = args.size() > 0 ? args[0] : "-";
+    string outputPath = args.size() > 1 ? args[1] : "-";
+    int threads = args.size() > 2 ? atoi(args[2].c_str()) : 0;
+    if (threads <= 0)
+        threads = ThreadPool::defaultThreads();
+
+    ifstream inputFile;
+    if (inputPath != "-")
+    {
+        inputFile.open(inputPath);
+        if (!inputFile.is_open())
+        {
+            cerr << "Cant open the query file - " << inputPath << endl;
+            return 1;
+        }
+    }
+    istream &input = inputPath == "-" ? cin : inputFile;
+
+    ofstream outputFile;
+    if (outputPath != "-")
+    {
+        outputFile.open(outputPath);
+        if (!outputFile.is_open())
+        {
+            cerr << "Cant create the result file - " << outputPath << endl;
+            return 1;
+        }
+    }
+    ostream &output = outputPath == "-" ? cout : outputFile;
+
+    auto loadStart = chrono::steady_clock::now();
+
+    CSRGraph graph;
+    if (!loadDhakaGraph(graph))
+        return 1;
+
+    // every query line up front, so records can be slotted back in input order
+    vector<unique_ptr<BatchQuery>> queries;
+    string line;
+    int lineNumber = 0;
+    while (getline(input, line))
+    {
+        lineNumber++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#')
+            continue;
+
+        queries.emplace_back(new BatchQuery());
+        queries.back()->lineNumber = lineNumber;
+        queries.back()->line = line;
+    }
+
+    auto queryStart = chrono::steady_clock::now();
+
+    vector<unique_ptr<RouteSolver>> solvers;
+    vector<unique_ptr<QueryGraph>> checkGraphs; // --check's own searches, one per thread
+    vector<SearchContext> checkNodes(threads);
+    for (int w = 0; w < threads; w++)
+    {
+        solvers.emplace_back(new RouteSolver(graph));
+        checkGraphs.emplace_back(new QueryGraph(graph));
+    }
+
+    mutex checkMutex;
+    int checkFailures = 0;
+
+    thread answering([&] {
+        forEachStealing(queries.size(), threads, [&](int worker, int i) {
+            BatchQuery &query = *queries[i];
+            auto start = chrono::steady_clock::now();
+
+            RouteQuery request;
+            RouteResult result;
+            string error, id = to_string(query.lineNumber);
+            if (!parseRouteQuery(query.line, request, error))
+                query.record = formatResultCSV(id, request, result, error);
+            else if (request.changes)
+            {
+                vector<RouteResult> options = solvers[worker]->solveOptions(request);
+                for (const RouteResult &option : options)
+                    query.record += (query.record.empty() ? "" : "\n") + formatResultCSV(id, request, option);
+                if (options.empty())
+                    query.record = formatResultCSV(id, request, result);
+                else
+                    result = options.back();
+                query.problem = request.problem;
+
+                string wrong = check ? checkOptions(*solvers[worker], request, options) : "";
+                if (!wrong.empty())
+                {
+                    lock_guard<mutex> lock(checkMutex);
+                    cerr << "line " << id << ": " << wrong << endl;
+                    checkFailures++;
+                }
+            }
+            else
+            {
+                result = solvers[worker]->solve(request);
+                query.record = formatResultCSV(id, request, result);
+                query.problem = request.problem;
+
+                bool deadline = request.scheduledTime != numeric_limits<double>::infinity();
+                string wrong = check && deadline ? checkDeadline(*checkGraphs[worker], checkNodes[worker], request, result) : "";
+                if (!wrong.empty())
+                {
+                    lock_guard<mutex> lock(checkMutex);
+                    cerr << "line " << id << ": " << wrong << endl;
+                    checkFailures++;
+                }
+            }
+            query.settled = result.settled;
+
+            query.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            query.done.store(true, memory_order_release);
+        });
+    });
+
+    output << RESULT_CSV_HEADER << '\n';
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        while (!queries[i]->done.load(memory_order_acquire))
+            this_thread::sleep_for(chrono::microseconds(200));
+        output << queries[i]->record << '\n';
+        queries[i]->record.clear();
+    }
+    output.flush();
+    answering.join();
+
+    auto end = chrono::steady_clock::now();
+    double loadSeconds = chrono::duration<double>(queryStart - loadStart).count();
+    double querySeconds = chrono::duration<double>(end - queryStart).count();
+
+    int failed = 0;
+    long long settled = 0;
+    vector<double> latencies;
+    vector<vector<double>> latenciesByProblem(PROBLEMS + 1);
+    for (const unique_ptr<BatchQuery> &query : queries)
+    {
+        failed += query->problem == 0;
+        settled += query->settled;
+        latencies.push_back(query->milliseconds);
+        latenciesByProblem[query->problem].push_back(query->milliseconds);
+    }
+
+    size_t count = queries.size();
+    cerr << count << " queries (" << failed << " invalid) on " << threads << " threads, graph loaded in " << loadSeconds << " s, answered in "
+         << querySeconds << " s";
+    if (count)
+        cerr << " (" << count / querySeconds << " queries/s, " << settled / (long long)count << " nodes settled per query)";
+    cerr << endl;
+
+    reportLatency("all", latencies);
+    for (int problem = 1; problem <= PROBLEMS; problem++)
+        reportLatency("Problem " + to_string(problem), latenciesByProblem[problem]);
+
+    if (check)
+    {
+        cerr << "check: " << checkFailures << " changes queries disagree with the connection scan or scheduled queries miss a path" << endl;
+        if (checkFailures)
+            return 1;
+    }
+
+    return 0;
+}
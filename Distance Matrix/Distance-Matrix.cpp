@@ -0,0 +1,218 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Graph/DhakaGraph.h"
+#include "../Graph/DistanceMatrix.h"
+
+using namespace std;
+
+/*
+    Cost from every source to every target, for a dispatcher that needs the
+    whole table at once:
+
+        cd "Distance Matrix"
+        g++ -O2 -pthread Distance-Matrix.cpp -o Distance-Matrix
+        ./Distance-Matrix 1 sources.txt targets.txt matrix.csv
+        ./Distance-Matrix 4 sources.txt targets.txt matrix.bin 05:43pm
+        ./Distance-Matrix 1 depots.txt all trees.bin
+
+    The point files hold one "longitude latitude" per line, blank lines and
+    lines starting with # are skipped. Row i of the matrix is source i,
+    column j target j, each value what the problem minimises (km, Tk, or
+    minutes travelled for Problem 5). Problems 4-6 need the starting time,
+    Problem 6 also the scheduled time.
+
+    Targets "all" is one-to-all: column v is graph vertex v, every source a
+    whole shortest path tree by delta-stepping on every core (DeltaStepping.h).
+    --check then recomputes every row with dijkstra() and reports the cells
+    that differ, exiting 1 if any do.
+
+    A .bin output gets the binary matrix of DistanceMatrix.h, anything else
+    CSV with empty cells where there is no path; "-" or no output writes
+    the CSV to stdout.
+
+    --pairing-heap runs the searches on the pairing heap instead of the
+    4-ary heap (PriorityQueue.h), same matrix, to compare the two on the
+    stderr timing.
+*/
+bool readPoints(const string &path, vector<pair<double, double>> &points)
+{
+    ifstream file(path);
+    if (!file.is_open())
+    {
+        cerr << "Cant open the point file - " << path << endl;
+        return false;
+    }
+
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line))
+    {
+        lineNumber++;
+
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos || line[first] == '#')
+            continue;
+
+        pair<double, double> lonLat;
+        string rest;
+        istringstream in(line);
+        if (!(in >> lonLat.first >> lonLat.second) || in >> rest)
+        {
+            cerr << path << " line " << lineNumber << ": expected longitude latitude" << endl;
+            return false;
+        }
+        points.push_back(lonLat);
+    }
+    return true;
+}
+
+// Cells of a one-to-all matrix that dijkstra() disagrees with, reported to stderr
+long long checkOneToAll(const ProblemSpec &problem, const vector<pair<double, double>> &sources, const CSRGraph &graph,
+                        const DistanceMatrix &matrix, double startingTime, double scheduledTime)
+{
+    QueryGraph query(graph);
+    vector<int> sourceIDs;
+    for (const pair<double, double> &lonLat : sources)
+        sourceIDs.push_back(query.attach(lonLat, problem.modes));
+
+    SearchContext nodes;
+    long long cells = 0, differ = 0;
+    for (int i = 0; i < matrix.rows; i++)
+    {
+        if (sourceIDs[i] == -1)
+            continue;
+
+        dijkstra(problem, sourceIDs[i], nodes, query, startingTime, scheduledTime);
+        for (int v = 1; v < matrix.columns; v++)
+        {
+            cells++;
+            if (matrixValue(problem, nodes[v], startingTime) != matrix.at(i, v))
+            {
+                if (differ++ < 10)
+                    cerr << "source " << i << " vertex " << v << ": " << matrix.at(i, v) << ", dijkstra "
+                         << matrixValue(problem, nodes[v], startingTime) << endl;
+            }
+        }
+    }
+
+    cerr << "checked " << cells << " cells against dijkstra, " << differ << " differ" << endl;
+    return differ;
+}
+
+int main(int argc, char *argv[])
+{
+    bool pairingHeap = false, check = false;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--pairing-heap")
+            pairingHeap = true;
+        else if (string(argv[i]) == "--check")
+            check = true;
+        else
+            args.push_back(argv[i]);
+    }
+
+    if (args.size() < 3)
+    {
+        cerr << "usage: Distance-Matrix [--pairing-heap] [--check] problem sources targets|all [output] [startingTime] [scheduledTime]" << endl;
+        return 1;
+    }
+
+    int number = atoi(args[0].c_str());
+    if (number < 1 || number > PROBLEMS)
+    {
+        cerr << "problem must be 1 to " << PROBLEMS << endl;
+        return 1;
+    }
+    const ProblemSpec &problem = problemSpec(number);
+
+    string outputPath = args.size() > 3 ? args[3] : "-";
+    double startingTime = 0, scheduledTime = numeric_limits<double>::infinity();
+
+    if (problem.timed)
+    {
+        if (args.size() < 5 || !isTimeOfDay(args[4]))
+        {
+            cerr << "expected a starting time like 05:43pm" << endl;
+            return 1;
+        }
+        startingTime = convertTimeToMinutes(args[4]);
+    }
+    if (number == 6)
+    {
+        if (args.size() < 6 || !isTimeOfDay(args[5]))
+        {
+            cerr << "expected a scheduled time like 08:40pm" << endl;
+            return 1;
+        }
+        scheduledTime = convertTimeToMinutes(args[5]);
+    }
+
+    vector<pair<double, double>> sources, targets;
+    bool oneToAll = args[2] == "all";
+    if (!readPoints(args[1], sources) || (!oneToAll && !readPoints(args[2], targets)))
+        return 1;
+    if (check && !oneToAll)
+    {
+        cerr << "--check is for one-to-all (targets all)" << endl;
+        return 1;
+    }
+
+    bool binary = outputPath.size() > 4 && outputPath.compare(outputPath.size() - 4, 4, ".bin") == 0;
+
+    ofstream outputFile;
+    if (outputPath != "-")
+    {
+        outputFile.open(outputPath, binary ? ios::binary : ios::out);
+        if (!outputFile.is_open())
+        {
+            cerr << "Cant create the matrix file - " << outputPath << endl;
+            return 1;
+        }
+    }
+    ostream &output = outputPath == "-" ? cout : outputFile;
+
+    auto loadStart = chrono::steady_clock::now();
+
+    CSRGraph graph;
+    if (!loadDhakaGraph(graph))
+        return 1;
+
+    auto matrixStart = chrono::steady_clock::now();
+
+    DistanceMatrix matrix;
+    ThreadPool pool;
+    if (oneToAll)
+        matrix = pairingHeap ? oneToAllMatrix<PairingHeap>(problem, sources, graph, pool, startingTime, scheduledTime)
+                             : oneToAllMatrix(problem, sources, graph, pool, startingTime, scheduledTime);
+    else
+        matrix = pairingHeap ? distanceMatrix<PairingHeap>(problem, sources, targets, graph, startingTime, scheduledTime)
+                             : distanceMatrix(problem, sources, targets, graph, startingTime, scheduledTime);
+
+    auto end = chrono::steady_clock::now();
+
+    if (check && checkOneToAll(problem, sources, graph, matrix, startingTime, scheduledTime) != 0)
+        return 1;
+
+    if (!(binary ? writeMatrixBinary(output, matrix) : writeMatrixCSV(output, matrix)))
+    {
+        cerr << "Cant write the matrix file - " << outputPath << endl;
+        return 1;
+    }
+
+    double loadSeconds = chrono::duration<double>(matrixStart - loadStart).count();
+    double matrixSeconds = chrono::duration<double>(end - matrixStart).count();
+
+    cerr << matrix.rows << " x " << matrix.columns << " matrix, graph loaded in " << loadSeconds << " s, computed in " << matrixSeconds << " s" << endl;
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <string>
+
+#include "../Graph/DhakaGraph.h"
+
+using namespace std;
+
+/*
+    Parses the four CSV files once and writes ../Dhaka.graph, which every
+    Problem program maps at startup instead of parsing the CSV files again.
+    The snapshot also carries the ALT landmark tables (Landmarks.h), the
+    Contraction Hierarchies (ContractionHierarchy.h), the topology of the
+    customizable hierarchy (Customizable.h) and the hub labels
+    (HubLabels.h). Run it again whenever a dataset or a problem's fares
+    change.
+
+        cd "Graph Compile"
+        g++ -O2 -pthread Graph-Compile.cpp -o Graph-Compile
+        ./Graph-Compile
+*/
+int main(int argc, char *argv[])
+{
+    string root = argc > 1 ? argv[1] : "..";
+    string snapshotPath = root + "/Dhaka.graph";
+
+    CSRGraph graph;
+    if (!buildGraph_from_datasets(root, graph))
+        return 1;
+
+    graph.landmarks = buildLandmarks(graph);
+    graph.hierarchy = buildContractionHierarchy(graph);
+    graph.customizable = buildCustomizableGraph(graph);
+    graph.hubLabels = buildHubLabels(*graph.hierarchy, HUB_LABEL_PROBLEMS);
+
+    SnapshotWriter writer;
+    addGraphSections(writer, graph);
+    addLandmarkSections(writer, *graph.landmarks);
+    addHierarchySections(writer, *graph.hierarchy);
+    addCustomizableSections(writer, *graph.customizable);
+    addHubLabelSections(writer, *graph.hubLabels);
+
+    string error;
+    if (!writer.write(snapshotPath, error))
+    {
+        cout << "Could not write the snapshot - " << error << endl;
+        return 1;
+    }
+
+    cout << "Vertices = " << graph.vertexCount() - 1 << endl;
+    cout << "Edges = " << graph.edgeCount() << endl;
+    cout << "Landmarks = " << graph.landmarks->count << " for each of Problems";
+    for (int m = 0; m < graph.landmarks->metrics; m++)
+        cout << " " << graph.landmarks->problem[m];
+    cout << endl;
+    cout << "Shortcuts = " << graph.hierarchy->arcs << " upward arcs over Problems";
+    for (int m = 0; m < graph.hierarchy->metrics; m++)
+        cout << " " << graph.hierarchy->problem[m];
+    cout << endl;
+    cout << "Customizable arcs = " << graph.customizable->arcs << endl;
+    cout << "Hub labels = " << graph.hubLabels->entries << " entries over Problems";
+    for (int m = 0; m < graph.hubLabels->metrics; m++)
+        cout << " " << graph.hubLabels->problem[m];
+    cout << endl;
+    cout << "Snapshot written to " << snapshotPath << endl;
+
+    return 0;
+}
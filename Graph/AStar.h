@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "Geo.h"
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+
+/*
+    Lower bound on the cost of travelling one km for `problem`, read off its
+    mode tables so it stays valid whenever they change:
+
+        MIN_DISTANCE  1 km
+        MIN_COST      the cheapest costPerKM of the problem's modes (Tk)
+        MIN_ARRIVAL   60 / the fastest speed of the problem's modes (minutes)
+
+    Waiting for a vehicle only adds time, and no edge is shorter than the
+    straight line between its ends, so haversine km times this never
+    overestimates. A free mode (walking in Problems 2-4 and 6) makes it 0.
+*/
+inline double costPerKMBound(const ProblemSpec &problem)
+{
+    if (problem.objective == MIN_DISTANCE)
+        return 1;
+
+    double bound = std::numeric_limits<double>::infinity();
+    for (int mode = 1; mode <= 5; mode++)
+    {
+        if (!(problem.modes >> mode & 1))
+            continue;
+
+        if (problem.objective == MIN_COST)
+            bound = std::min(bound, problem.costPerKM[mode]);
+        else if (problem.speed[mode] > 0)
+            bound = std::min(bound, 60.0 / problem.speed[mode]);
+    }
+    return bound == std::numeric_limits<double>::infinity() ? 0 : bound;
+}
+
+// A* potential: straight-line km to the destination times the problem's cheapest km
+struct GoalBound
+{
+    const QueryGraph &graph;
+    std::pair<double, double> goal;
+    double perKM;
+
+    GoalBound(const ProblemSpec &problem, const QueryGraph &graph, int dst)
+        : graph(graph), goal(graph.lonLat(dst)), perKM(costPerKMBound(problem) * SHRINK) {}
+
+    double operator()(int v) const
+    {
+        return perKM ? perKM * haversine(graph.lonLat(v), goal) : 0;
+    }
+
+    // split edges are a share of their segment's length, a hair off the haversine of their own ends
+    static constexpr double SHRINK = 1 - 1e-4;
+};
+
+/*
+    A* from src to dst, the point-to-point dijkstraTo() guided by GoalBound.
+    Same cost to dst, with fewer nodes settled the more the bound tells;
+    with a bound of 0 it is exactly dijkstraTo(). Returns the number of
+    nodes settled.
+*/
+template <class Queue = QuadHeap>
+inline int astar(const ProblemSpec &problem, int src, int dst, SearchContext &nodes, const QueryGraph &graph,
+                 double startingTime = 0, double scheduledTime = std::numeric_limits<double>::infinity())
+{
+    return dijkstraTo<Queue>(problem, src, std::vector<int>(1, dst), nodes, graph, startingTime, scheduledTime, GoalBound(problem, graph, dst));
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <climits>
+#include <vector>
+
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+
+/*
+    Bidirectional Dijkstra for the problems without a timetable (1-3).
+
+    One search grows from src and one from dst, always advancing the side
+    whose next node is nearer. Every edge scanned that reaches a node the
+    other side has labelled is a candidate meeting point, the best one so
+    far costs `best`. Once the two queue minimums add up to `best` no
+    shorter path can be left, and the search stops with each side having
+    covered about half the radius of a one-sided search.
+
+    The backward search walks the edges leaving a node as if they entered
+    it, which needs every edge to have a twin the other way with the same
+    length and mode. The datasets add every segment in both directions and
+    QueryGraph does the same for its walking and split edges.
+
+    The result is written to `nodes` the way dijkstraTo() writes it: the
+    path is extractPath(nodes, dst), and along it cost, prev and prevEdge
+    are what a forward search would give. Other nodes hold whatever the
+    forward side had reached.
+*/
+template <class Queue = QuadHeap>
+inline int bidirectionalDijkstra(const ProblemSpec &problem, int src, int dst, SearchContext &nodes, const QueryGraph &graph)
+{
+    int n = graph.vertexCount();
+
+    static thread_local SearchContext backward; // prev is the next node towards dst, prevEdge the edge leaving it back to this node
+    nodes.reset(n);
+    backward.reset(n);
+    nodes[src].cost = 0;
+    backward[dst].cost = 0;
+
+    static thread_local Queue forwardQueue, backwardQueue;
+    forwardQueue.reset(n);
+    backwardQueue.reset(n);
+    forwardQueue.push(src, 0);
+    backwardQueue.push(dst, 0);
+
+    double best = src == dst ? 0 : INT_MAX;
+    int meet = src == dst ? src : -1;
+    int settled = 0;
+
+    while (!forwardQueue.empty() && !backwardQueue.empty())
+    {
+        double forwardTop = forwardQueue.top().first;
+        double backwardTop = backwardQueue.top().first;
+        if (forwardTop + backwardTop >= best)
+            break;
+
+        bool forwardSide = forwardTop <= backwardTop;
+        Queue &queue = forwardSide ? forwardQueue : backwardQueue;
+        SearchContext &mine = forwardSide ? nodes : backward;
+        const SearchContext &other = forwardSide ? backward : nodes;
+
+        int v = queue.pop().second;
+        settled++;
+
+        for (int e : graph.edges(v))
+        {
+            int mode = graph.mode(e);
+            if (!(problem.modes >> mode & 1))
+                continue;
+
+            int u = graph.target(e);
+            if (queue.done(u))
+                continue;
+
+            double cost = mine[v].cost + edgeWeight(problem, graph.length(e), mode);
+            if (mine[u].cost > cost)
+            {
+                mine[u].cost = cost;
+                mine[u].prev = v;
+                mine[u].prevEdge = e;
+                queue.push(u, cost);
+            }
+
+            if (other[u].cost != INT_MAX && mine[u].cost + other[u].cost < best)
+            {
+                best = mine[u].cost + other[u].cost;
+                meet = u;
+            }
+        }
+    }
+
+    if (meet == -1)
+        return settled; // dst unreachable, so the forward side never got to it either
+
+    // continue the forward labels from the meeting point to dst, over the twins of the backward edges
+    for (int v = meet; v != dst;)
+    {
+        int next = backward[v].prev;
+        int back = backward[v].prevEdge; // next -> v
+
+        int twin = -1;
+        for (int e : graph.edges(v))
+            if (graph.target(e) == next && graph.mode(e) == graph.mode(back) && graph.length(e) == graph.length(back))
+            {
+                twin = e;
+                break;
+            }
+
+        nodes[next].cost = nodes[v].cost + edgeWeight(problem, graph.length(twin), graph.mode(twin));
+        nodes[next].prev = v;
+        nodes[next].prevEdge = twin;
+        v = next;
+    }
+
+    return settled;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Geo.h"
+#include "SpatialIndex.h"
+
+// Sets of transport modes are bit masks, bit `mode` set for every mode in the set
+const unsigned ALL_MODES = (1 << 1) | (1 << 2) | (1 << 3) | (1 << 4) | (1 << 5);
+
+// Query points are snapped onto the road map (Roadmap-Dhaka.csv)
+const unsigned ROAD_MODES = 1 << 2;
+
+struct Landmarks;            // Landmarks.h
+struct ContractionHierarchy; // ContractionHierarchy.h
+struct CustomizableGraph;    // Customizable.h
+struct HubLabels;            // HubLabels.h
+
+// One directed edge as it comes out of the datasets, before packing
+struct GraphEdge
+{
+    int from;
+    int to;
+    double length; // km
+    int mode;      // 1->Walk, 2->Car, 3->Metro, 4->Uttara Bus, 5->Bikolpo Bus
+};
+
+// A pair of opposite edges of one mode, from < to
+struct GraphSegment
+{
+    int from;
+    int to;
+    int mode;
+};
+
+// Where a point meets its nearest segment
+struct SegmentMatch
+{
+    GraphSegment segment;
+    double t;                        // 0 at segment.from, 1 at segment.to
+    std::pair<double, double> point; // the matched point on the segment
+    double distance;                 // km from the query point
+};
+
+/*
+    Compressed sparse row graph, built once and never changed afterwards.
+    Outgoing edges of vertex v are the slots offset[v] .. offset[v + 1] - 1
+    of the target / length / mode arrays, so walking an adjacency list is a
+    linear scan over contiguous memory. Vertex 0 is unused (IDs are 1-based).
+
+    The arrays are plain pointers into `storage`, which is either vectors
+    built from the datasets or a memory-mapped snapshot (see Snapshot.h).
+    Copies share the storage, so one loaded graph can be handed to any
+    number of readers. Edge weights are not stored, every problem derives
+    its own from length and mode.
+*/
+struct CSRGraph
+{
+    const int *offset = nullptr;
+    const int *target = nullptr;
+    const double *length = nullptr;
+    const unsigned char *mode = nullptr;
+    const double *lon = nullptr;
+    const double *lat = nullptr;
+
+    int vertices = 0;
+    int edges = 0;
+
+    std::shared_ptr<const void> storage;
+
+    // Grids for snapping query points, built by buildIndexes() once the arrays are set
+    struct Indexes
+    {
+        SpatialIndex vertices;
+        std::vector<GraphSegment> segmentList;
+        SpatialIndex segments;
+    };
+    std::shared_ptr<const Indexes> indexes;
+
+    // ALT distance tables, when the snapshot has them
+    std::shared_ptr<const Landmarks> landmarks;
+
+    // Contraction Hierarchies, when the snapshot has them
+    std::shared_ptr<const ContractionHierarchy> hierarchy;
+
+    // Metric-independent hierarchy to customize any problem's costs on, when the snapshot has it
+    std::shared_ptr<const CustomizableGraph> customizable;
+
+    // Hub labels read off the hierarchy, when the snapshot has them
+    std::shared_ptr<const HubLabels> hubLabels;
+
+    CSRGraph() {}
+
+    // lon_lats[v] is the coordinate of vertex v, edges keep the order they
+    // were emitted in within each vertex (counting sort)
+    CSRGraph(const std::vector<std::pair<double, double>> &lon_lats, const std::vector<GraphEdge> &edgeList)
+    {
+        auto arrays = std::make_shared<Arrays>();
+        int vertexCount = lon_lats.size();
+
+        arrays->offset.assign(vertexCount + 1, 0);
+        for (const GraphEdge &edge : edgeList)
+            arrays->offset[edge.from + 1]++;
+
+        for (int v = 0; v < vertexCount; v++)
+            arrays->offset[v + 1] += arrays->offset[v];
+
+        arrays->target.resize(edgeList.size());
+        arrays->length.resize(edgeList.size());
+        arrays->mode.resize(edgeList.size());
+
+        std::vector<int> next(arrays->offset.begin(), arrays->offset.end() - 1);
+        for (const GraphEdge &edge : edgeList)
+        {
+            int slot = next[edge.from]++;
+
+            arrays->target[slot] = edge.to;
+            arrays->length[slot] = edge.length;
+            arrays->mode[slot] = edge.mode;
+        }
+
+        arrays->lon.resize(vertexCount);
+        arrays->lat.resize(vertexCount);
+        for (int v = 0; v < vertexCount; v++)
+        {
+            arrays->lon[v] = lon_lats[v].first;
+            arrays->lat[v] = lon_lats[v].second;
+        }
+
+        offset = arrays->offset.data();
+        target = arrays->target.data();
+        length = arrays->length.data();
+        mode = arrays->mode.data();
+        lon = arrays->lon.data();
+        lat = arrays->lat.data();
+
+        vertices = vertexCount;
+        edges = edgeList.size();
+        storage = arrays;
+
+        buildIndexes();
+    }
+
+    void buildIndexes()
+    {
+        auto built = std::make_shared<Indexes>();
+
+        std::vector<GeoBox> boxes(vertices, GeoBox::none());
+        for (int v = 1; v < vertices; v++)
+            boxes[v] = GeoBox::point(lonLat(v));
+        built->vertices = SpatialIndex(boxes);
+
+        boxes.clear();
+        for (int u = 1; u < vertices; u++)
+            for (int e = offset[u]; e < offset[u + 1]; e++)
+                if (u < target[e])
+                {
+                    built->segmentList.push_back({u, target[e], mode[e]});
+                    boxes.push_back(GeoBox::segment(lonLat(u), lonLat(target[e])));
+                }
+        built->segments = SpatialIndex(boxes);
+
+        indexes = built;
+    }
+
+    int vertexCount() const
+    {
+        return vertices;
+    }
+
+    int edgeCount() const
+    {
+        return edges;
+    }
+
+    std::pair<double, double> lonLat(int v) const
+    {
+        return {lon[v], lat[v]};
+    }
+
+    // true when one of v's edges has a mode in `modes`
+    bool hasModeIn(int v, unsigned modes) const
+    {
+        for (int e = offset[v]; e < offset[v + 1]; e++)
+            if (modes >> mode[e] & 1)
+                return true;
+        return false;
+    }
+
+    /*
+        Nearest vertex other than `avoid` with an edge of one of `modes`,
+        -1 when there is none. `distance` gets the haversine distance in km.
+    */
+    int nearestVertex(std::pair<double, double> lon_lat, unsigned modes, int avoid, double &distance) const
+    {
+        std::vector<std::pair<double, int>> found = indexes->vertices.nearest(lon_lat, 1, [&](int v) {
+            if (v == avoid || !hasModeIn(v, modes))
+                return std::numeric_limits<double>::infinity();
+            return haversine(lon_lat, lonLat(v));
+        });
+
+        distance = found.empty() ? std::numeric_limits<double>::infinity() : found[0].first;
+        return found.empty() ? -1 : found[0].second;
+    }
+
+    // Nearest point on a segment with a mode in `modes`, false when there is none
+    bool nearestSegment(std::pair<double, double> lon_lat, unsigned modes, SegmentMatch &match) const
+    {
+        std::vector<std::pair<double, int>> found = indexes->segments.nearest(lon_lat, 1, [&](int s) {
+            const GraphSegment &segment = indexes->segmentList[s];
+            if (!(modes >> segment.mode & 1))
+                return std::numeric_limits<double>::infinity();
+
+            double t = projectOnSegment(lon_lat, lonLat(segment.from), lonLat(segment.to));
+            return haversine(lon_lat, interpolate(lonLat(segment.from), lonLat(segment.to), t));
+        });
+
+        if (found.empty())
+            return false;
+
+        match.segment = indexes->segmentList[found[0].second];
+        match.t = projectOnSegment(lon_lat, lonLat(match.segment.from), lonLat(match.segment.to));
+        match.point = interpolate(lonLat(match.segment.from), lonLat(match.segment.to), match.t);
+        match.distance = found[0].first;
+        return true;
+    }
+
+private:
+    struct Arrays
+    {
+        std::vector<int> offset;
+        std::vector<int> target;
+        std::vector<double> length;
+        std::vector<unsigned char> mode;
+        std::vector<double> lon;
+        std::vector<double> lat;
+    };
+};
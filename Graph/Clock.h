@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cctype>
+#include <cstdio>
+#include <string>
+
+// "05:43pm" -> minutes after midnight, 0 when the text is not a time
+inline double convertTimeToMinutes(const std::string &timeStr)
+{
+    int hours, minutes;
+    char ampm[3];
+
+    if (sscanf(timeStr.c_str(), "%d:%d%2s", &hours, &minutes, ampm) < 3)
+    {
+        return 0.0;
+    }
+    std::string marker = ampm;
+    for (char &c : marker)
+        c = tolower(c);
+
+    if (marker == "pm" && hours < 12)
+    {
+        hours += 12;
+    }
+    else if (marker == "am" && hours == 12)
+    {
+        hours = 0;
+    }
+
+    return static_cast<double>(hours * 60 + minutes);
+}
+
+// true for text convertTimeToMinutes understands, like "05:43pm" or "6:45AM"
+inline bool isTimeOfDay(const std::string &timeStr)
+{
+    int hours, minutes, length = 0;
+    char ampm[3];
+
+    if (sscanf(timeStr.c_str(), "%d:%d%2s%n", &hours, &minutes, ampm, &length) < 3 || length != (int)timeStr.size())
+        return false;
+
+    std::string marker = ampm;
+    for (char &c : marker)
+        c = tolower(c);
+
+    return (marker == "am" || marker == "pm") && hours >= 1 && hours <= 12 && minutes >= 0 && minutes < 60;
+}
+
+// Minutes after midnight -> "05:43pm", wrapping around midnight
+inline std::string convertMinutesToTime(double totalMinutes)
+{
+    int total = static_cast<int>(totalMinutes);
+
+    total %= 1440;
+    if (total < 0)
+        total += 1440;
+
+    int hours = total / 60;
+    int minutes = total % 60;
+
+    std::string period = (hours >= 12) ? "pm" : "am";
+
+    int displayHour = hours % 12;
+    if (displayHour == 0)
+        displayHour = 12;
+
+    char buffer[10];
+    std::snprintf(buffer, sizeof(buffer), "%02d:%02d%s", displayHour, minutes, period.c_str());
+
+    return std::string(buffer);
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "AStar.h"
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "Timetable.h"
+
+/*
+    Connection Scan: earliest arrival over a Timetable. All metro and bus
+    legs are one array sorted by departure and are scanned once, in order.
+    A connection is taken when its vehicle is ridden already or its stop
+    has been reached by the time it leaves, and then its arrival stop is
+    reached no later than its arrival. No queue and no adjacency lists,
+    the transit part of a query is one pass over contiguous memory.
+
+    Getting to, from and between stops is on foot or by car over the road
+    graph, which has no timetable. A query alternates the two: a Dijkstra
+    over the problem's walk and car edges from the stops the last scan
+    reached (first from the source), then a scan from the earliest time
+    that search improved, until a round improves nothing. Changing
+    vehicles at one stop happens within a scan, every round adds a change
+    by road. Both stop at the best arrival found at the destination, and
+    the road searches head for it with the straight-line time bound of
+    GoalBound, whatever the problem minimises.
+*/
+
+/*
+    Earliest arrival at dst leaving src at `startingTime`, no later than
+    `scheduledTime`, with the metro and buses of `timetable` (built for
+    the same problem). The path to dst is written to `nodes` like
+    dijkstraTo() does, arrival times and waits along the vehicles actually
+    taken and cost as the problem counts it (the fare, or the arrival for
+    Problem 5); other nodes only keep their arrival. Returns the nodes the
+    road searches settled plus the connections taken.
+*/
+template <class Queue = QuadHeap>
+inline int connectionScan(const ProblemSpec &problem, const Timetable &timetable, int src, int dst, SearchContext &nodes, const QueryGraph &graph,
+                          double startingTime, double scheduledTime = std::numeric_limits<double>::infinity())
+{
+    int n = graph.vertexCount();
+    nodes.reset(n);
+
+    // connection that last reached each vertex (-1: the road), stop index each trip was boarded at (-1: not ridden)
+    static thread_local std::vector<int> reachedBy, boardedAt;
+    if ((int)reachedBy.size() < n)
+        reachedBy.resize(n, -1);
+    if (boardedAt.size() < timetable.tripStart.size())
+        boardedAt.resize(timetable.tripStart.size(), -1);
+
+    // stops the last scan reached, and what to clear on the way out
+    static thread_local std::vector<int> seeds, touched, ridden;
+    seeds.assign(1, src);
+    touched.clear();
+    ridden.clear();
+
+    unsigned roadModes = 0;
+    for (int mode = 1; mode <= 5; mode++)
+        if ((problem.modes >> mode & 1) && !problem.runsEvery[mode])
+            roadModes |= 1u << mode;
+
+    nodes[src].cost = startingTime;
+    nodes[src].arrivalTime = startingTime;
+
+    ProblemSpec fastest = problem;
+    fastest.objective = MIN_ARRIVAL;
+    GoalBound potential(fastest, graph, dst);
+
+    static thread_local Queue queue;
+    int settled = 0;
+    double scanFrom = startingTime;
+    while (!seeds.empty())
+    {
+        queue.reset(n);
+        for (int v : seeds)
+            queue.push(v, nodes[v].arrivalTime + potential(v));
+        seeds.clear();
+
+        while (!queue.empty())
+        {
+            std::pair<double, int> top = queue.pop();
+            if (top.first >= nodes[dst].arrivalTime)
+                break;
+
+            int v = top.second;
+            settled++;
+
+            for (int e : graph.edges(v))
+            {
+                int mode = graph.mode(e);
+                if (!(roadModes >> mode & 1))
+                    continue;
+
+                int u = graph.target(e);
+                double arrivalTime = nodes[v].arrivalTime + graph.length(e) / problem.speed[mode] * 60.0;
+                if (arrivalTime > scheduledTime || arrivalTime >= nodes[u].arrivalTime)
+                    continue;
+
+                nodes[u] = {arrivalTime, v, e, arrivalTime, 0};
+                reachedBy[u] = -1;
+                scanFrom = std::min(scanFrom, arrivalTime);
+                queue.push(u, arrivalTime + potential(u));
+            }
+        }
+
+        if (scanFrom == INT_MAX)
+            break;
+
+        for (int c = timetable.firstDeparture(scanFrom); c < (int)timetable.connections.size(); c++)
+        {
+            const TransitConnection &connection = timetable.connections[c];
+            if (connection.departure >= nodes[dst].arrivalTime)
+                break;
+
+            // boarding only where the vehicle leaves inside service hours; a later round may board a trip further up
+            int &boarded = boardedAt[connection.trip];
+            if (boarded == -1 || connection.index < boarded)
+            {
+                if (connection.departure > SERVICE_END || nodes[connection.from].arrivalTime > connection.departure)
+                    continue;
+                if (boarded == -1)
+                    ridden.push_back(connection.trip);
+                boarded = connection.index;
+            }
+
+            if (connection.arrival > scheduledTime || connection.arrival >= nodes[connection.to].arrivalTime)
+                continue;
+
+            nodes[connection.to] = {connection.arrival, connection.from, connection.edge, connection.arrival, 0};
+            reachedBy[connection.to] = c;
+            touched.push_back(connection.to);
+            seeds.push_back(connection.to);
+            settled++;
+        }
+        scanFrom = INT_MAX;
+    }
+
+    // the journey to dst, back along road labels and the trips that reached the stops
+    std::vector<std::pair<int, Node>> trip;
+    if (nodes[dst].arrivalTime != INT_MAX)
+    {
+        for (int v = dst; v != src;)
+        {
+            int c = reachedBy[v];
+            if (c == -1)
+            {
+                trip.push_back({v, nodes[v]});
+                v = nodes[v].prev;
+                continue;
+            }
+
+            const TransitConnection &exit = timetable.connections[c];
+            const TransitLine &line = timetable.lines[timetable.tripLine[exit.trip]];
+            int board = boardedAt[exit.trip];
+            for (int i = exit.index; i >= board; i--)
+            {
+                double arrival = timetable.departure(exit.trip, i + 1);
+                double waiting = i == board ? timetable.departure(exit.trip, board) - nodes[line.stops[board]].arrivalTime : 0;
+                trip.push_back({line.stops[i + 1], Node{arrival, line.stops[i], line.edges[i], arrival, waiting}});
+            }
+            v = line.stops[board];
+        }
+        trip.push_back({src, nodes[src]});
+        std::reverse(trip.begin(), trip.end());
+    }
+
+    for (int v : touched)
+        reachedBy[v] = -1;
+    for (int t : ridden)
+        boardedAt[t] = -1;
+
+    writeTrip(trip, nodes);
+    writePathCosts(problem, dst, nodes, graph);
+    return settled;
+}
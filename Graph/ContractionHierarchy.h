@@ -0,0 +1,721 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "Landmarks.h"
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+/*
+    Contraction Hierarchies for the problems with fixed edge costs (1-3).
+
+    Preprocessing removes ("contracts") the vertices one by one, least
+    important first. Removing v adds a shortcut u-x of cost
+    cost(u, v) + cost(v, x) between two of its neighbours unless a witness
+    search finds a path at least as cheap that avoids v. Every vertex keeps
+    the arcs it had when it was removed, all of them to vertices removed
+    later: its upward arcs. A shortest path always climbs and then
+    descends, so a query only searches upward, from both ends, and meets at
+    the top; a few hundred vertices are settled instead of thousands.
+
+    The graph has every edge both ways with the same cost, so one set of
+    upward arcs serves both searches. Shortcuts remember the vertex they
+    bypass, a found path is unpacked back to graph edges and comes out
+    exactly as a search over the graph would give it.
+
+    Preprocessing contracts rounds of vertices in parallel: every vertex
+    whose priority (shortcuts it needs - arcs it removes + neighbours
+    already removed) is lower than all its neighbours'. Their witness
+    searches avoid the whole round, so contracting them together is exact.
+    Graph-compile stores the result in the snapshot.
+*/
+struct ContractionHierarchy
+{
+    int metrics = 0;
+    int vertices = 0;
+    size_t arcs = 0;
+
+    const int *problem = nullptr;          // [metrics]
+    const uint64_t *fingerprint = nullptr; // [metrics], metricFingerprint() when built
+    const int *offset = nullptr;           // [metric * (vertices + 1) + v], upward arcs of v are the slots offset .. next offset - 1
+    const int *target = nullptr;           // [arcs]
+    const double *weight = nullptr;        // [arcs]
+    const int *middle = nullptr;           // [arcs], the vertex a shortcut bypasses, -1 for an edge of the graph
+
+    std::shared_ptr<const void> storage;
+
+    // hierarchy for a problem, -1 when it has none or its costs changed since
+    int metricOf(int number) const
+    {
+        for (int m = 0; m < metrics; m++)
+            if (problem[m] == number && fingerprint[m] == metricFingerprint(problemSpec(number)))
+                return m;
+        return -1;
+    }
+
+    const int *offsets(int metric) const
+    {
+        return offset + (size_t)metric * (vertices + 1);
+    }
+
+    // appends the graph vertices after x on arc slot `arc` between x and y, y last
+    void unpack(int metric, int arc, int x, int y, std::vector<int> &path) const
+    {
+        int via = middle[arc];
+        if (via == -1)
+        {
+            path.push_back(y);
+            return;
+        }
+
+        // both halves were upward arcs of the bypassed vertex
+        const int *first = offsets(metric);
+        int toX = -1, toY = -1;
+        for (int a = first[via]; a < first[via + 1]; a++)
+        {
+            if (target[a] == x)
+                toX = a;
+            else if (target[a] == y)
+                toY = a;
+        }
+        unpack(metric, toX, x, via, path);
+        unpack(metric, toY, via, y, path);
+    }
+};
+
+// Arc of the graph being contracted, both directions are stored
+struct HierarchyArc
+{
+    int target;
+    double weight;
+    int middle;
+};
+
+class HierarchyBuilder
+{
+public:
+    HierarchyBuilder(const CSRGraph &graph, const ProblemSpec &problem, ThreadPool &pool)
+        : vertices(graph.vertexCount()), pool(pool)
+    {
+        adjacency.resize(vertices);
+        for (int u = 1; u < vertices; u++)
+            for (int e = graph.offset[u]; e < graph.offset[u + 1]; e++)
+            {
+                int mode = graph.mode[e];
+                int v = graph.target[e];
+                if (v != u && (problem.modes >> mode & 1))
+                    addOrLower(u, v, edgeWeight(problem, graph.length[e], mode), -1);
+            }
+    }
+
+    // contracts every vertex, up[v] gets the upward arcs of v
+    void build(std::vector<std::vector<HierarchyArc>> &up)
+    {
+        up.assign(vertices, std::vector<HierarchyArc>());
+        inRound.assign(vertices, 0);
+        removedNeighbours.assign(vertices, 0);
+        priority.assign(vertices, 0);
+
+        std::vector<int> remaining;
+        for (int v = 1; v < vertices; v++)
+            remaining.push_back(v);
+        updatePriorities(remaining);
+
+        std::vector<std::vector<Shortcut>> shortcuts;
+        while (!remaining.empty())
+        {
+            std::vector<int> round, rest;
+            for (int v : remaining)
+                (isLocalMinimum(v) ? round : rest).push_back(v);
+
+            for (int v : round)
+                inRound[v] = 1;
+
+            shortcuts.assign(round.size(), std::vector<Shortcut>());
+            forEachInParallel(round.size(), [&](int i, WitnessSearch &witness) { findShortcuts(round[i], witness, shortcuts[i]); });
+
+            std::vector<int> touched;
+            for (size_t i = 0; i < round.size(); i++)
+            {
+                int v = round[i];
+                up[v] = adjacency[v];
+
+                for (const HierarchyArc &arc : adjacency[v])
+                {
+                    removeArc(arc.target, v);
+                    removedNeighbours[arc.target]++;
+                    touched.push_back(arc.target);
+                }
+                adjacency[v].clear();
+
+                for (const Shortcut &shortcut : shortcuts[i])
+                {
+                    addOrLower(shortcut.from, shortcut.to, shortcut.weight, v);
+                    addOrLower(shortcut.to, shortcut.from, shortcut.weight, v);
+                }
+            }
+
+            for (int v : round)
+                inRound[v] = 0;
+
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+            updatePriorities(touched); // neighbours of the round, none of them in it
+
+            remaining.swap(rest);
+        }
+    }
+
+private:
+    struct Shortcut
+    {
+        int from;
+        int to;
+        double weight;
+    };
+
+    // Dijkstra over the remaining graph with per-thread labels reset by generation
+    struct WitnessSearch
+    {
+        std::vector<double> cost;
+        std::vector<unsigned> seen;
+        unsigned generation = 0;
+        std::vector<std::pair<double, int>> heap;
+
+        double costOf(int v) const
+        {
+            return seen[v] == generation ? cost[v] : std::numeric_limits<double>::infinity();
+        }
+    };
+
+    // a witness search gives up after settling this many vertices, which only costs extra shortcuts
+    static constexpr int WITNESS_SETTLE_LIMIT = 500;
+
+    int vertices;
+    ThreadPool &pool;
+    std::vector<std::vector<HierarchyArc>> adjacency; // the remaining graph
+    std::vector<char> inRound;
+    std::vector<int> removedNeighbours;
+    std::vector<int> priority;
+
+    void addOrLower(int u, int v, double weight, int middle)
+    {
+        for (HierarchyArc &arc : adjacency[u])
+            if (arc.target == v)
+            {
+                if (weight < arc.weight)
+                {
+                    arc.weight = weight;
+                    arc.middle = middle;
+                }
+                return;
+            }
+        adjacency[u].push_back({v, weight, middle});
+    }
+
+    void removeArc(int u, int v)
+    {
+        std::vector<HierarchyArc> &arcs = adjacency[u];
+        for (size_t i = 0; i < arcs.size(); i++)
+            if (arcs[i].target == v)
+            {
+                arcs.erase(arcs.begin() + i);
+                return;
+            }
+    }
+
+    bool isLocalMinimum(int v) const
+    {
+        for (const HierarchyArc &arc : adjacency[v])
+        {
+            int u = arc.target;
+            if (priority[u] < priority[v] || (priority[u] == priority[v] && u < v))
+                return false;
+        }
+        return true;
+    }
+
+    // runs task(i, witness) for i in 0 .. count-1 on the pool, one witness search per chunk
+    void forEachInParallel(int count, const std::function<void(int, WitnessSearch &)> &task)
+    {
+        int chunks = std::min(count, pool.size() * 4);
+        for (int c = 0; c < chunks; c++)
+        {
+            pool.submit([&, c, chunks] {
+                WitnessSearch witness;
+                witness.cost.resize(vertices);
+                witness.seen.assign(vertices, 0);
+
+                for (int i = c; i < count; i += chunks)
+                    task(i, witness);
+            });
+        }
+        pool.wait();
+    }
+
+    void updatePriorities(const std::vector<int> &list)
+    {
+        forEachInParallel(list.size(), [&](int i, WitnessSearch &witness) {
+            int v = list[i];
+            std::vector<Shortcut> needed;
+            findShortcuts(v, witness, needed);
+            priority[v] = (int)needed.size() - (int)adjacency[v].size() + removedNeighbours[v];
+        });
+    }
+
+    // costs from `from` over the remaining graph, not through v or the current round, up to `limit`
+    // or until the arcs of v from `arc` on are all settled
+    void runWitness(WitnessSearch &witness, int from, int v, size_t arc, double limit) const
+    {
+        const std::vector<HierarchyArc> &targets = adjacency[v];
+        size_t open = targets.size() - arc;
+
+        witness.generation++;
+        witness.heap.clear();
+        witness.cost[from] = 0;
+        witness.seen[from] = witness.generation;
+        witness.heap.push_back({0, from});
+
+        std::greater<std::pair<double, int>> later;
+        int settled = 0;
+        while (!witness.heap.empty() && settled < WITNESS_SETTLE_LIMIT)
+        {
+            std::pop_heap(witness.heap.begin(), witness.heap.end(), later);
+            std::pair<double, int> top = witness.heap.back();
+            witness.heap.pop_back();
+
+            int x = top.second;
+            if (top.first > witness.cost[x])
+                continue; // stale entry
+            if (top.first > limit)
+                break;
+            settled++;
+
+            for (size_t j = arc; j < targets.size(); j++)
+                if (targets[j].target == x)
+                    open--;
+            if (open == 0)
+                break;
+
+            for (const HierarchyArc &arc : adjacency[x])
+            {
+                int y = arc.target;
+                if (y == v || inRound[y])
+                    continue;
+
+                double cost = top.first + arc.weight;
+                if (cost <= limit && cost < witness.costOf(y))
+                {
+                    witness.cost[y] = cost;
+                    witness.seen[y] = witness.generation;
+                    witness.heap.push_back({cost, y});
+                    std::push_heap(witness.heap.begin(), witness.heap.end(), later);
+                }
+            }
+        }
+    }
+
+    // pairs of v's neighbours that lose their shortest path when v goes
+    void findShortcuts(int v, WitnessSearch &witness, std::vector<Shortcut> &shortcuts) const
+    {
+        const std::vector<HierarchyArc> &arcs = adjacency[v];
+
+        for (size_t i = 0; i + 1 < arcs.size(); i++)
+        {
+            double longest = 0;
+            for (size_t j = i + 1; j < arcs.size(); j++)
+                longest = std::max(longest, arcs[j].weight);
+            runWitness(witness, arcs[i].target, v, i + 1, arcs[i].weight + longest);
+
+            for (size_t j = i + 1; j < arcs.size(); j++)
+            {
+                double through = arcs[i].weight + arcs[j].weight;
+                if (witness.costOf(arcs[j].target) > through)
+                    shortcuts.push_back({arcs[i].target, arcs[j].target, through});
+            }
+        }
+    }
+};
+
+// Hierarchies for every problem without a timetable, contracted on `threads` threads (0: all)
+inline std::shared_ptr<const ContractionHierarchy> buildContractionHierarchy(const CSRGraph &graph, int threads = 0)
+{
+    struct Tables
+    {
+        std::vector<int> problem;
+        std::vector<uint64_t> fingerprint;
+        std::vector<int> offset;
+        std::vector<int> target;
+        std::vector<double> weight;
+        std::vector<int> middle;
+    };
+    auto tables = std::make_shared<Tables>();
+
+    ThreadPool pool(threads);
+    int vertices = graph.vertexCount();
+
+    for (int number = 1; number <= PROBLEMS; number++)
+    {
+        const ProblemSpec &problem = problemSpec(number);
+        if (problem.timed)
+            continue;
+
+        std::vector<std::vector<HierarchyArc>> up;
+        HierarchyBuilder(graph, problem, pool).build(up);
+
+        tables->problem.push_back(number);
+        tables->fingerprint.push_back(metricFingerprint(problem));
+        for (int v = 0; v < vertices; v++)
+        {
+            tables->offset.push_back(tables->target.size());
+            for (const HierarchyArc &arc : up[v])
+            {
+                tables->target.push_back(arc.target);
+                tables->weight.push_back(arc.weight);
+                tables->middle.push_back(arc.middle);
+            }
+        }
+        tables->offset.push_back(tables->target.size());
+    }
+
+    auto hierarchy = std::make_shared<ContractionHierarchy>();
+    hierarchy->metrics = tables->problem.size();
+    hierarchy->vertices = vertices;
+    hierarchy->arcs = tables->target.size();
+    hierarchy->problem = tables->problem.data();
+    hierarchy->fingerprint = tables->fingerprint.data();
+    hierarchy->offset = tables->offset.data();
+    hierarchy->target = tables->target.data();
+    hierarchy->weight = tables->weight.data();
+    hierarchy->middle = tables->middle.data();
+    hierarchy->storage = tables;
+    return hierarchy;
+}
+
+inline void addHierarchySections(SnapshotWriter &writer, const ContractionHierarchy &hierarchy)
+{
+    writer.add(SECTION_CH_PROBLEMS, hierarchy.problem, hierarchy.metrics);
+    writer.add(SECTION_CH_TABLES, hierarchy.fingerprint, hierarchy.metrics);
+    writer.add(SECTION_CH_OFFSET, hierarchy.offset, (size_t)hierarchy.metrics * (hierarchy.vertices + 1));
+    writer.add(SECTION_CH_TARGET, hierarchy.target, hierarchy.arcs);
+    writer.add(SECTION_CH_WEIGHT, hierarchy.weight, hierarchy.arcs);
+    writer.add(SECTION_CH_MIDDLE, hierarchy.middle, hierarchy.arcs);
+}
+
+// Points graph.hierarchy into the mapped snapshot, false with an empty error when it has none
+inline bool readHierarchySections(const std::shared_ptr<const Snapshot> &snapshot, CSRGraph &graph, std::string &error)
+{
+    size_t metrics, fingerprints, offsets, targets, weights, middles;
+    auto hierarchy = std::make_shared<ContractionHierarchy>();
+
+    hierarchy->problem = snapshot->section<int>(SECTION_CH_PROBLEMS, metrics);
+    hierarchy->fingerprint = snapshot->section<uint64_t>(SECTION_CH_TABLES, fingerprints);
+    hierarchy->offset = snapshot->section<int>(SECTION_CH_OFFSET, offsets);
+    hierarchy->target = snapshot->section<int>(SECTION_CH_TARGET, targets);
+    hierarchy->weight = snapshot->section<double>(SECTION_CH_WEIGHT, weights);
+    hierarchy->middle = snapshot->section<int>(SECTION_CH_MIDDLE, middles);
+
+    error = "";
+    if (!hierarchy->problem && !hierarchy->fingerprint && !hierarchy->offset && !hierarchy->target && !hierarchy->weight && !hierarchy->middle)
+        return false;
+
+    int vertices = graph.vertexCount();
+    if (!hierarchy->problem || !hierarchy->fingerprint || !hierarchy->offset || !hierarchy->target || !hierarchy->weight || !hierarchy->middle ||
+        metrics == 0 || fingerprints != metrics || offsets != metrics * (vertices + 1) || weights != targets || middles != targets)
+    {
+        error = "hierarchy sections are missing or inconsistent";
+        return false;
+    }
+
+    // a broken offset or arc would send a query out of the arrays
+    for (size_t i = 0; i < offsets; i++)
+        if (hierarchy->offset[i] < 0 || (size_t)hierarchy->offset[i] > targets || (i % (vertices + 1) && hierarchy->offset[i] < hierarchy->offset[i - 1]))
+        {
+            error = "hierarchy offsets out of range";
+            return false;
+        }
+    for (size_t a = 0; a < targets; a++)
+        if (hierarchy->target[a] < 1 || hierarchy->target[a] >= vertices || hierarchy->middle[a] < -1 || hierarchy->middle[a] >= vertices)
+        {
+            error = "hierarchy arc out of range";
+            return false;
+        }
+
+    hierarchy->metrics = metrics;
+    hierarchy->vertices = vertices;
+    hierarchy->arcs = targets;
+    hierarchy->storage = snapshot;
+    graph.hierarchy = hierarchy;
+    return true;
+}
+
+// Cost from one end of a query over its own vertices, prev leads back to that end
+struct OverlayLabel
+{
+    int vertex;
+    double cost;
+    int prev;
+};
+
+inline int findLabel(const std::vector<OverlayLabel> &labels, int v)
+{
+    for (size_t i = 0; i < labels.size(); i++)
+        if (labels[i].vertex == v)
+            return i;
+    return -1;
+}
+
+/*
+    Labels from `from` over the query's own vertices (the snapped source or
+    destination and the split points), stopping at the graph vertices they
+    hang off. Those are where the hierarchy search starts. There are only a
+    handful, so they are kept in a list instead of a label per vertex.
+*/
+inline void labelOverlay(const ProblemSpec &problem, int from, const QueryGraph &graph, std::vector<OverlayLabel> &labels)
+{
+    int base = graph.graph.vertexCount();
+    labels.assign(1, {from, 0, -1});
+
+    std::vector<char> settled(1, 0);
+    while (true)
+    {
+        int next = -1;
+        for (size_t i = 0; i < labels.size(); i++)
+            if (!settled[i] && (next == -1 || labels[i].cost < labels[next].cost))
+                next = i;
+        if (next == -1)
+            break;
+
+        settled[next] = 1;
+        OverlayLabel label = labels[next];
+        if (label.vertex < base)
+            continue; // the hierarchy takes it from here
+
+        for (int e : graph.edges(label.vertex))
+        {
+            int mode = graph.mode(e);
+            if (!(problem.modes >> mode & 1))
+                continue;
+
+            int u = graph.target(e);
+            double cost = label.cost + edgeWeight(problem, graph.length(e), mode);
+            int at = findLabel(labels, u);
+            if (at == -1)
+            {
+                labels.push_back({u, cost, label.vertex});
+                settled.push_back(0);
+            }
+            else if (cost < labels[at].cost)
+            {
+                labels[at].cost = cost;
+                labels[at].prev = label.vertex;
+            }
+        }
+    }
+}
+
+// Appends the vertices from v to the end `labels` were measured from, v itself left out
+inline void overlayChain(const std::vector<OverlayLabel> &labels, int v, std::vector<int> &chain)
+{
+    for (int u = labels[findLabel(labels, v)].prev; u != -1; u = labels[findLabel(labels, u)].prev)
+        chain.push_back(u);
+}
+
+// Labels `nodes` along path (from nodes[path[0]]) over the cheapest edge between each pair, as a forward search picks them
+inline void writePath(const ProblemSpec &problem, const std::vector<int> &path, SearchContext &nodes, const QueryGraph &graph)
+{
+    for (size_t i = 1; i < path.size(); i++)
+    {
+        int from = path[i - 1], to = path[i];
+
+        int chosen = -1;
+        double chosenWeight = 0;
+        for (int e : graph.edges(from))
+        {
+            int mode = graph.mode(e);
+            if (graph.target(e) != to || !(problem.modes >> mode & 1))
+                continue;
+
+            double weight = edgeWeight(problem, graph.length(e), mode);
+            if (chosen == -1 || weight < chosenWeight)
+            {
+                chosen = e;
+                chosenWeight = weight;
+            }
+        }
+
+        nodes[to].cost = nodes[from].cost + chosenWeight;
+        nodes[to].prev = from;
+        nodes[to].prevEdge = chosen;
+    }
+}
+
+// One upward search, kept between the queries of a thread so a query only clears what it touched
+template <class Queue>
+struct HierarchySide
+{
+    std::vector<double> cost;
+    std::vector<int> parent;    // previous vertex on the upward path, -1 at a start vertex
+    std::vector<int> parentArc; // arc slot from parent
+    std::vector<int> touched;
+    Queue queue;
+
+    void reset(int n)
+    {
+        if ((int)cost.size() != n)
+        {
+            cost.assign(n, std::numeric_limits<double>::infinity());
+            parent.assign(n, -1);
+            parentArc.assign(n, -1);
+        }
+        for (int v : touched)
+        {
+            cost[v] = std::numeric_limits<double>::infinity();
+            parent[v] = -1;
+        }
+        touched.clear();
+        queue.reset(n);
+    }
+
+    void label(int v, double c, int from, int arc)
+    {
+        if (cost[v] == std::numeric_limits<double>::infinity())
+            touched.push_back(v);
+        cost[v] = c;
+        parent[v] = from;
+        parentArc[v] = arc;
+        queue.push(v, c);
+    }
+};
+
+/*
+    Query from src to dst over one metric of a hierarchy: both upward
+    searches start from where the query's vertices join the graph and stop
+    once neither queue can beat the best meeting point. The path is
+    unpacked into graph edges and written to `nodes` the way dijkstraTo()
+    writes it, so extractPath(), prevEdge and writeKML() work unchanged;
+    nodes off the path are left unreached. `problem` must be the costs the
+    metric was built with. Returns the number of vertices settled.
+*/
+template <class Queue = QuadHeap>
+inline int hierarchySearch(const ProblemSpec &problem, const ContractionHierarchy &hierarchy, int metric, int src, int dst,
+                           SearchContext &nodes, const QueryGraph &graph)
+{
+    int base = graph.graph.vertexCount();
+    const int *first = hierarchy.offsets(metric);
+
+    nodes.reset(graph.vertexCount());
+    nodes[src].cost = 0;
+
+    std::vector<OverlayLabel> labels[2]; // from src, towards dst
+    labelOverlay(problem, src, graph, labels[0]);
+    labelOverlay(problem, dst, graph, labels[1]);
+
+    double best = INT_MAX;
+    int meet = -1;
+    bool meetInOverlay = false;
+    for (const OverlayLabel &label : labels[0])
+    {
+        int at = findLabel(labels[1], label.vertex);
+        if (at != -1 && label.cost + labels[1][at].cost < best)
+        {
+            best = label.cost + labels[1][at].cost;
+            meet = label.vertex;
+            meetInOverlay = true;
+        }
+    }
+
+    static thread_local HierarchySide<Queue> sides[2];
+    for (int s = 0; s < 2; s++)
+    {
+        sides[s].reset(base);
+        for (const OverlayLabel &label : labels[s])
+            if (label.vertex < base)
+                sides[s].label(label.vertex, label.cost, -1, -1);
+    }
+
+    int settled = 0;
+    while (true)
+    {
+        bool forwardOpen = !sides[0].queue.empty() && sides[0].queue.top().first < best;
+        bool backwardOpen = !sides[1].queue.empty() && sides[1].queue.top().first < best;
+        if (!forwardOpen && !backwardOpen)
+            break;
+
+        int s = forwardOpen && (!backwardOpen || sides[0].queue.top().first <= sides[1].queue.top().first) ? 0 : 1;
+        HierarchySide<Queue> &side = sides[s];
+        const HierarchySide<Queue> &other = sides[1 - s];
+
+        int v = side.queue.pop().second;
+        settled++;
+
+        if (side.cost[v] + other.cost[v] < best)
+        {
+            best = side.cost[v] + other.cost[v];
+            meet = v;
+            meetInOverlay = false;
+        }
+
+        for (int a = first[v]; a < first[v + 1]; a++)
+        {
+            int u = hierarchy.target[a];
+            double cost = side.cost[v] + hierarchy.weight[a];
+            if (cost < side.cost[u])
+                side.label(u, cost, v, a);
+        }
+    }
+
+    if (meet == -1)
+        return settled;
+
+    // vertices from src to dst: overlay, up the hierarchy, down the hierarchy, overlay
+    std::vector<int> path(1, meet);
+    int forwardStart = meet, backwardStart = meet;
+    if (!meetInOverlay)
+    {
+        std::vector<int> upward(1, meet);
+        for (int v = meet; sides[0].parent[v] != -1; v = sides[0].parent[v])
+            upward.push_back(sides[0].parent[v]);
+        forwardStart = upward.back();
+
+        path.assign(1, forwardStart);
+        for (int i = (int)upward.size() - 1; i > 0; i--)
+            hierarchy.unpack(metric, sides[0].parentArc[upward[i - 1]], upward[i], upward[i - 1], path);
+
+        for (int v = meet; sides[1].parent[v] != -1; v = sides[1].parent[v])
+            hierarchy.unpack(metric, sides[1].parentArc[v], v, sides[1].parent[v], path);
+        backwardStart = path.back();
+    }
+
+    std::vector<int> head;
+    overlayChain(labels[0], forwardStart, head);
+    path.insert(path.begin(), head.rbegin(), head.rend());
+    overlayChain(labels[1], backwardStart, path);
+
+    writePath(problem, path, nodes, graph);
+    return settled;
+}
+
+// Contraction Hierarchy query for Problems 1-3, alt() when the graph has no hierarchy for the problem
+template <class Queue = QuadHeap>
+inline int chSearch(const ProblemSpec &problem, int src, int dst, SearchContext &nodes, const QueryGraph &graph)
+{
+    const ContractionHierarchy *hierarchy = graph.graph.hierarchy.get();
+    int metric = hierarchy ? hierarchy->metricOf(problem.number) : -1;
+    if (metric == -1)
+        return alt<Queue>(problem, src, dst, nodes, graph);
+
+    return hierarchySearch<Queue>(problem, *hierarchy, metric, src, dst, nodes, graph);
+}
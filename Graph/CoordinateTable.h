@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*
+    Coordinate -> vertex ID table used while reading the datasets.
+
+    Coordinates are quantized to 1e-6 degree (the datasets carry six
+    decimals) and packed into one 64 bit key, so two coordinates merge
+    exactly when they round to the same micro-degree, regardless of how the
+    decimal text was parsed. The table is open addressing with linear
+    probing, kept at most half full.
+
+    operator[] behaves like std::map: a missing coordinate is inserted with
+    ID 0, which the callers treat as "no vertex yet".
+*/
+class CoordinateTable
+{
+public:
+    CoordinateTable()
+    {
+        rehash(16);
+    }
+
+    // make room for `count` coordinates in total without growing on the way
+    void reserve(size_t count)
+    {
+        size_t capacity = keys.size();
+        while (capacity < count * 2)
+            capacity *= 2;
+
+        if (capacity != keys.size())
+            rehash(capacity);
+    }
+
+    int &operator[](std::pair<double, double> lon_lat)
+    {
+        uint64_t key = quantize(lon_lat);
+
+        size_t slot = findSlot(key);
+        if (ids[slot] != -1)
+            return ids[slot];
+
+        if ((count + 1) * 2 > keys.size())
+        {
+            rehash(keys.size() * 2);
+            slot = findSlot(key);
+        }
+
+        count++;
+        keys[slot] = key;
+        ids[slot] = 0;
+        return ids[slot];
+    }
+
+    // vertex ID of a coordinate, 0 when it is not in the table
+    int find(std::pair<double, double> lon_lat) const
+    {
+        size_t slot = findSlot(quantize(lon_lat));
+        return ids[slot] == -1 ? 0 : ids[slot];
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    static uint64_t quantize(std::pair<double, double> lon_lat)
+    {
+        int64_t lon = std::llround(lon_lat.first * 1e6);
+        int64_t lat = std::llround(lon_lat.second * 1e6);
+
+        return ((uint64_t)(uint32_t)lon << 32) | (uint32_t)lat;
+    }
+
+private:
+    std::vector<uint64_t> keys;
+    std::vector<int> ids; // -1 marks an empty slot
+    size_t count = 0;
+
+    static size_t hash(uint64_t key)
+    {
+        // splitmix64 finalizer, spreads the nearby micro-degree keys apart
+        key ^= key >> 30;
+        key *= 0xbf58476d1ce4e5b9ULL;
+        key ^= key >> 27;
+        key *= 0x94d049bb133111ebULL;
+        key ^= key >> 31;
+        return key;
+    }
+
+    size_t findSlot(uint64_t key) const
+    {
+        size_t mask = keys.size() - 1;
+        size_t slot = hash(key) & mask;
+
+        while (ids[slot] != -1 && keys[slot] != key)
+            slot = (slot + 1) & mask;
+
+        return slot;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<uint64_t> oldKeys;
+        std::vector<int> oldIds;
+        oldKeys.swap(keys);
+        oldIds.swap(ids);
+
+        keys.assign(capacity, 0);
+        ids.assign(capacity, -1);
+
+        for (size_t i = 0; i < oldKeys.size(); i++)
+            if (oldIds[i] != -1)
+            {
+                size_t slot = findSlot(oldKeys[i]);
+                keys[slot] = oldKeys[i];
+                ids[slot] = oldIds[i];
+            }
+    }
+};
@@ -0,0 +1,456 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "ContractionHierarchy.h"
+#include "Landmarks.h"
+#include "Routing.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+/*
+    Customizable Contraction Hierarchies: the hierarchy of
+    ContractionHierarchy.h split into a part that only depends on the road
+    and rail topology and a part that depends on the costs.
+
+    The topology part is built once by graph-compile. Vertices are ordered
+    by nested dissection: the map is cut in two along the straight line
+    with the fewest vertices on the cut, both halves are ordered
+    recursively and the cut vertices go last. Contracting in that order
+    without any witness search (every mode counts, costs are unknown)
+    gives the upward arcs every metric can need. Cuts in a road map are
+    small, so this stays a few arcs per vertex.
+
+    customize() then fills in costs for one ProblemSpec: every arc starts
+    with its cheapest edge of an allowed mode (infinite when there is
+    none) and is lowered over each triangle with a vertex below both ends,
+    bottom-up. Vertices of one level of the elimination tree write only
+    their own arcs, so a level is customized in parallel. The result is an
+    ordinary ContractionHierarchy for hierarchySearch(); changing a fare
+    table only takes another customize(), no new graph-compile.
+*/
+struct CustomizableGraph
+{
+    int vertices = 0;
+    size_t arcs = 0;
+
+    const int *order = nullptr;  // [vertices], vertices from first to last contracted (0 first, unused)
+    const int *offset = nullptr; // [vertices + 1], upward arcs of v are the slots offset[v] .. offset[v + 1] - 1
+    const int *target = nullptr; // [arcs], by order of contraction within each vertex
+
+    std::shared_ptr<const void> storage;
+
+    // worked out when loaded: arcs into each vertex from below, and the levels customize() runs by
+    std::vector<int> downOffset; // [vertices + 1]
+    std::vector<int> downArc;    // [arcs], arc slots
+    std::vector<int> downSource; // [arcs], the vertex each arc leaves
+    std::vector<int> levelStart; // levels are levelVertices[levelStart[l]] .. [levelStart[l + 1] - 1]
+    std::vector<int> levelVertices;
+
+    void prepare()
+    {
+        downOffset.assign(vertices + 1, 0);
+        for (size_t a = 0; a < arcs; a++)
+            downOffset[target[a] + 1]++;
+        for (int v = 0; v < vertices; v++)
+            downOffset[v + 1] += downOffset[v];
+
+        downArc.resize(arcs);
+        downSource.resize(arcs);
+        std::vector<int> next(downOffset.begin(), downOffset.end() - 1);
+        for (int v = 0; v < vertices; v++)
+            for (int a = offset[v]; a < offset[v + 1]; a++)
+            {
+                int at = next[target[a]]++;
+                downArc[at] = a;
+                downSource[at] = v;
+            }
+
+        // a vertex is one level above the highest vertex below it
+        std::vector<int> level(vertices, 0);
+        int levels = 0;
+        for (int i = 0; i < vertices; i++)
+        {
+            int v = order[i];
+            for (int a = offset[v]; a < offset[v + 1]; a++)
+                level[target[a]] = std::max(level[target[a]], level[v] + 1);
+            levels = std::max(levels, level[v] + 1);
+        }
+
+        levelStart.assign(levels + 1, 0);
+        for (int v = 0; v < vertices; v++)
+            levelStart[level[v] + 1]++;
+        for (int l = 0; l < levels; l++)
+            levelStart[l + 1] += levelStart[l];
+
+        levelVertices.resize(vertices);
+        next.assign(levelStart.begin(), levelStart.end() - 1);
+        for (int v = 0; v < vertices; v++)
+            levelVertices[next[level[v]]++] = v;
+    }
+};
+
+// parts this small are not cut any further
+const int DISSECTION_LEAF = 32;
+
+class DissectionOrder
+{
+public:
+    explicit DissectionOrder(const CSRGraph &graph)
+        : graph(graph), partOf(graph.vertexCount(), -1), sideOf(graph.vertexCount(), 0) {}
+
+    // vertices from first to last to contract
+    std::vector<int> build()
+    {
+        std::vector<int> all;
+        for (int v = 1; v < graph.vertexCount(); v++)
+            all.push_back(v);
+
+        order.assign(1, 0);
+        dissect(all);
+        return order;
+    }
+
+private:
+    const CSRGraph &graph;
+    std::vector<int> partOf; // label of the part a vertex is in while it is being cut
+    std::vector<char> sideOf;
+    std::vector<int> order;
+    int parts = 0;
+
+    // vertices of `side` with a neighbour in the part on the other side of the cut
+    void boundary(const std::vector<int> &part, int label, char side, std::vector<int> &cut) const
+    {
+        cut.clear();
+        for (int v : part)
+        {
+            if (sideOf[v] != side)
+                continue;
+            for (int e = graph.offset[v]; e < graph.offset[v + 1]; e++)
+            {
+                int u = graph.target[e];
+                if (partOf[u] == label && sideOf[u] != side)
+                {
+                    cut.push_back(v);
+                    break;
+                }
+            }
+        }
+    }
+
+    void dissect(std::vector<int> &part)
+    {
+        if ((int)part.size() <= DISSECTION_LEAF)
+        {
+            order.insert(order.end(), part.begin(), part.end());
+            return;
+        }
+
+        int label = parts++;
+        for (int v : part)
+            partOf[v] = label;
+
+        // median cuts across four directions, the one with the smallest boundary wins
+        static const double directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+        std::vector<int> best, cut;
+        std::vector<char> bestSide;
+        std::vector<std::pair<double, int>> projected(part.size());
+        for (const double *direction : directions)
+        {
+            for (size_t i = 0; i < part.size(); i++)
+            {
+                int v = part[i];
+                projected[i] = {graph.lon[v] * direction[0] + graph.lat[v] * direction[1], v};
+            }
+            std::nth_element(projected.begin(), projected.begin() + projected.size() / 2, projected.end());
+            for (size_t i = 0; i < projected.size(); i++)
+                sideOf[projected[i].second] = i >= projected.size() / 2;
+
+            for (char side = 0; side < 2; side++)
+            {
+                boundary(part, label, side, cut);
+                if (bestSide.empty() || cut.size() < best.size())
+                {
+                    best = cut;
+                    bestSide.assign(part.size(), 0);
+                    for (size_t i = 0; i < part.size(); i++)
+                        bestSide[i] = sideOf[part[i]];
+                }
+            }
+        }
+
+        for (int v : best)
+            partOf[v] = -2; // in the separator
+        std::vector<int> halves[2];
+        for (size_t i = 0; i < part.size(); i++)
+            if (partOf[part[i]] != -2)
+                halves[(int)bestSide[i]].push_back(part[i]);
+
+        std::vector<int>().swap(part);
+        dissect(halves[0]);
+        dissect(halves[1]);
+        order.insert(order.end(), best.begin(), best.end());
+    }
+};
+
+/*
+    Orders and contracts the whole graph, all modes. Contracting v joins
+    its remaining neighbours into a clique; handing them to the first of
+    them to be contracted is enough for that, it passes them on in turn.
+*/
+inline std::shared_ptr<CustomizableGraph> buildCustomizableGraph(const CSRGraph &graph)
+{
+    struct Tables
+    {
+        std::vector<int> order;
+        std::vector<int> offset;
+        std::vector<int> target;
+    };
+    auto tables = std::make_shared<Tables>();
+
+    int vertices = graph.vertexCount();
+    tables->order = DissectionOrder(graph).build();
+
+    std::vector<int> rank(vertices);
+    for (int i = 0; i < vertices; i++)
+        rank[tables->order[i]] = i;
+
+    auto byRank = [&](int a, int b) { return rank[a] < rank[b]; };
+    std::vector<std::vector<int>> up(vertices);
+    for (int v = 1; v < vertices; v++)
+    {
+        for (int e = graph.offset[v]; e < graph.offset[v + 1]; e++)
+            if (rank[graph.target[e]] > rank[v])
+                up[v].push_back(graph.target[e]);
+        std::sort(up[v].begin(), up[v].end(), byRank);
+        up[v].erase(std::unique(up[v].begin(), up[v].end()), up[v].end());
+    }
+
+    std::vector<int> merged;
+    for (int i = 0; i < vertices; i++)
+    {
+        int v = tables->order[i];
+        if (up[v].size() < 2)
+            continue;
+
+        int parent = up[v][0];
+        merged.clear();
+        std::set_union(up[parent].begin(), up[parent].end(), up[v].begin() + 1, up[v].end(), std::back_inserter(merged), byRank);
+        up[parent].swap(merged);
+    }
+
+    for (int v = 0; v < vertices; v++)
+    {
+        tables->offset.push_back(tables->target.size());
+        tables->target.insert(tables->target.end(), up[v].begin(), up[v].end());
+    }
+    tables->offset.push_back(tables->target.size());
+
+    auto customizable = std::make_shared<CustomizableGraph>();
+    customizable->vertices = vertices;
+    customizable->arcs = tables->target.size();
+    customizable->order = tables->order.data();
+    customizable->offset = tables->offset.data();
+    customizable->target = tables->target.data();
+    customizable->storage = tables;
+    customizable->prepare();
+    return customizable;
+}
+
+inline void addCustomizableSections(SnapshotWriter &writer, const CustomizableGraph &customizable)
+{
+    writer.add(SECTION_CCH_ORDER, customizable.order, customizable.vertices);
+    writer.add(SECTION_CCH_OFFSET, customizable.offset, customizable.vertices + 1);
+    writer.add(SECTION_CCH_TARGET, customizable.target, customizable.arcs);
+}
+
+// Points graph.customizable into the mapped snapshot, false with an empty error when it has none
+inline bool readCustomizableSections(const std::shared_ptr<const Snapshot> &snapshot, CSRGraph &graph, std::string &error)
+{
+    size_t orders, offsets, targets;
+    auto customizable = std::make_shared<CustomizableGraph>();
+
+    customizable->order = snapshot->section<int>(SECTION_CCH_ORDER, orders);
+    customizable->offset = snapshot->section<int>(SECTION_CCH_OFFSET, offsets);
+    customizable->target = snapshot->section<int>(SECTION_CCH_TARGET, targets);
+
+    error = "";
+    if (!customizable->order && !customizable->offset && !customizable->target)
+        return false;
+
+    int vertices = graph.vertexCount();
+    if (!customizable->order || !customizable->offset || !customizable->target ||
+        orders != (size_t)vertices || offsets != (size_t)vertices + 1 || customizable->offset[vertices] != (int)targets)
+    {
+        error = "customizable sections are missing or inconsistent";
+        return false;
+    }
+
+    // arcs must point up the order, or customize() would read costs not yet final
+    std::vector<int> rank(vertices, -1);
+    for (int i = 0; i < vertices; i++)
+    {
+        int v = customizable->order[i];
+        if (v < 0 || v >= vertices || rank[v] != -1)
+        {
+            error = "customizable order is not a permutation";
+            return false;
+        }
+        rank[v] = i;
+    }
+    for (int v = 0; v < vertices; v++)
+    {
+        if (customizable->offset[v] < 0 || customizable->offset[v] > customizable->offset[v + 1])
+        {
+            error = "customizable offsets out of range";
+            return false;
+        }
+        for (int a = customizable->offset[v]; a < customizable->offset[v + 1]; a++)
+            if (customizable->target[a] < 1 || customizable->target[a] >= vertices || rank[customizable->target[a]] <= rank[v])
+            {
+                error = "customizable arc out of range";
+                return false;
+            }
+    }
+
+    customizable->vertices = vertices;
+    customizable->arcs = targets;
+    customizable->storage = snapshot;
+    customizable->prepare();
+    graph.customizable = customizable;
+    return true;
+}
+
+/*
+    Costs of `problem` on the customizable graph, as a one-metric
+    ContractionHierarchy (metric 0) sharing its arcs. Any problem without a
+    timetable works, with the fares it carries: pass a changed copy of a
+    ProblemSpec to route with new fares.
+*/
+inline std::shared_ptr<const ContractionHierarchy> customize(const CustomizableGraph &customizable, const CSRGraph &graph,
+                                                             const ProblemSpec &problem, ThreadPool &pool)
+{
+    struct Tables
+    {
+        int problem;
+        uint64_t fingerprint;
+        std::vector<double> weight;
+        std::vector<int> middle;
+        std::shared_ptr<const void> arcs;
+    };
+    auto tables = std::make_shared<Tables>();
+    tables->problem = problem.number;
+    tables->fingerprint = metricFingerprint(problem);
+    tables->weight.assign(customizable.arcs, std::numeric_limits<double>::infinity());
+    tables->middle.assign(customizable.arcs, -1);
+    tables->arcs = customizable.storage;
+
+    double *weight = tables->weight.data();
+    int *middle = tables->middle.data();
+    const int *offset = customizable.offset;
+    const int *target = customizable.target;
+    int vertices = customizable.vertices;
+
+    for (size_t l = 0; l + 1 < customizable.levelStart.size(); l++)
+    {
+        int begin = customizable.levelStart[l], end = customizable.levelStart[l + 1];
+        int chunks = std::min(end - begin, pool.size() * 4);
+
+        for (int c = 0; c < chunks; c++)
+        {
+            pool.submit([&, c, chunks, begin, end] {
+                std::vector<int> slotOf(vertices, -1); // arc slot from v, for the vertex being customized
+
+                for (int i = begin + c; i < end; i += chunks)
+                {
+                    int v = customizable.levelVertices[i];
+                    for (int a = offset[v]; a < offset[v + 1]; a++)
+                        slotOf[target[a]] = a;
+
+                    for (int e = graph.offset[v]; e < graph.offset[v + 1]; e++)
+                    {
+                        int mode = graph.mode[e];
+                        int a = slotOf[graph.target[e]];
+                        if (a != -1 && (problem.modes >> mode & 1))
+                            weight[a] = std::min(weight[a], edgeWeight(problem, graph.length[e], mode));
+                    }
+
+                    // lower triangles: w below v with arcs to v and to x above v
+                    for (int d = customizable.downOffset[v]; d < customizable.downOffset[v + 1]; d++)
+                    {
+                        int toV = customizable.downArc[d];
+                        int w = customizable.downSource[d];
+                        for (int toX = toV + 1; toX < offset[w + 1]; toX++)
+                        {
+                            int a = slotOf[target[toX]];
+                            double through = weight[toV] + weight[toX];
+                            if (through < weight[a])
+                            {
+                                weight[a] = through;
+                                middle[a] = w;
+                            }
+                        }
+                    }
+
+                    for (int a = offset[v]; a < offset[v + 1]; a++)
+                        slotOf[target[a]] = -1;
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    auto hierarchy = std::make_shared<ContractionHierarchy>();
+    hierarchy->metrics = 1;
+    hierarchy->vertices = vertices;
+    hierarchy->arcs = customizable.arcs;
+    hierarchy->problem = &tables->problem;
+    hierarchy->fingerprint = &tables->fingerprint;
+    hierarchy->offset = offset;
+    hierarchy->target = target;
+    hierarchy->weight = weight;
+    hierarchy->middle = middle;
+    hierarchy->storage = tables;
+    return hierarchy;
+}
+
+// Problems with costs of their own, customized on one customizable graph
+struct MetricSet
+{
+    struct Metric
+    {
+        ProblemSpec problem;
+        std::shared_ptr<const ContractionHierarchy> hierarchy;
+    };
+    std::vector<Metric> metrics;
+
+    const Metric *find(int number) const
+    {
+        for (const Metric &metric : metrics)
+            if (metric.problem.number == number)
+                return &metric;
+        return nullptr;
+    }
+
+    // a copy with `problem` customized in, replacing its number's metric
+    std::shared_ptr<const MetricSet> with(const ProblemSpec &problem, const CSRGraph &graph, ThreadPool &pool) const
+    {
+        auto set = std::make_shared<MetricSet>(*this);
+        Metric metric = {problem, customize(*graph.customizable, graph, problem, pool)};
+
+        auto it = std::find_if(set->metrics.begin(), set->metrics.end(), [&](const Metric &m) { return m.problem.number == problem.number; });
+        if (it != set->metrics.end())
+            *it = metric;
+        else
+            set->metrics.push_back(metric);
+        return set;
+    }
+};
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "CoordinateTable.h"
+#include "Geo.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// Parses one CSV field with surrounding whitespace, false unless the whole field is a number
+inline bool parseNumber(const char *begin, const char *end, double &value)
+{
+    while (begin < end && isspace((unsigned char)*begin))
+        begin++;
+    while (end > begin && isspace((unsigned char)end[-1]))
+        end--;
+
+    std::from_chars_result result = std::from_chars(begin, end, value);
+    return result.ec == std::errc() && result.ptr == end && begin < end;
+}
+
+inline int getVertexID(CoordinateTable &nodeMap, std::vector<std::pair<double, double>> &vertices, std::pair<double, double> lon_lat)
+{
+    int &id = nodeMap[lon_lat]; // one probe, inserts the coordinate when it is new
+    if (id)
+        return id;
+
+    id = vertices.size();
+    vertices.push_back(lon_lat);
+
+    return id;
+}
+
+/*
+    A line-aligned piece of one mapped CSV file. Chunks are parsed
+    independently, each numbering its coordinates 1, 2, ... in the order it
+    first meets them, and merged afterwards (see buildGraph_from_datasets).
+*/
+struct DatasetChunk
+{
+    const std::string *fileName = nullptr;
+    const char *fileBegin = nullptr; // only for line numbers in error messages
+    const char *begin = nullptr;
+    const char *end = nullptr;
+    int mode = 0;
+
+    CoordinateTable nodeMap;
+    std::vector<std::pair<double, double>> vertices = std::vector<std::pair<double, double>>(1); // 1-based, chunk-local
+    std::vector<GraphEdge> edges;                                                              // chunk-local vertex IDs
+    std::string error;
+};
+
+/*
+    Parses the polylines of one chunk into chunk-local vertices and edges,
+    every segment in both directions. The text is scanned in place: fields
+    are located with memchr and numbers parsed with from_chars straight out
+    of the mapping, and the two per-line buffers are reused, so a line
+    costs no allocation once the buffers have grown to the longest line.
+*/
+inline bool parseDatasetChunk(DatasetChunk &chunk)
+{
+    // ~20 bytes of text per coordinate pair, size the table for the whole chunk up front
+    chunk.nodeMap.reserve((chunk.end - chunk.begin) / 20);
+
+    const char *text = chunk.begin;
+    const char *textEnd = chunk.end;
+
+    std::vector<const char *> fieldStart; // field i is fieldStart[i] .. fieldStart[i + 1] - 2
+    std::vector<std::pair<double, double>> lon_lats;
+
+    while (text < textEnd)
+    {
+        const char *lineEnd = (const char *)memchr(text, '\n', textEnd - text);
+        if (!lineEnd)
+            lineEnd = textEnd;
+
+        fieldStart.clear();
+        fieldStart.push_back(text);
+        for (const char *comma = text; (comma = (const char *)memchr(comma, ',', lineEnd - comma)); comma++)
+            fieldStart.push_back(comma + 1);
+        fieldStart.push_back(lineEnd + 1);
+
+        int fields = fieldStart.size() - 1;
+        if (fields > 1 && fieldStart[fields - 1] == lineEnd) // a trailing comma does not start another field
+            fields--;
+
+        /*
+            Lines are like this in the dataset -
+            Name,Longitude,Latitude,...,Name1,Name2   (Routemap files)
+            Name,Longitude,Latitude,...,0,Length      (Roadmap file)
+        */
+
+        lon_lats.clear();
+        for (int i = 1; i < fields - 3; i += 2)
+        {
+            double lon, lat;
+            if (!parseNumber(fieldStart[i], fieldStart[i + 1] - 1, lon) ||
+                !parseNumber(fieldStart[i + 1], fieldStart[i + 2] - 1, lat))
+            {
+                int lineNumber = 1 + std::count(chunk.fileBegin, text, '\n');
+                chunk.error = "Bad coordinate in " + *chunk.fileName + " line " + std::to_string(lineNumber);
+                return false;
+            }
+            lon_lats.push_back({lon, lat});
+        }
+
+        for (int i = 0; i + 1 < (int)lon_lats.size(); i++)
+        {
+            int u_id = getVertexID(chunk.nodeMap, chunk.vertices, lon_lats[i]);
+            int v_id = getVertexID(chunk.nodeMap, chunk.vertices, lon_lats[i + 1]);
+
+            double dist = haversine(lon_lats[i], lon_lats[i + 1]);
+
+            chunk.edges.push_back({u_id, v_id, dist, chunk.mode});
+            chunk.edges.push_back({v_id, u_id, dist, chunk.mode});
+        }
+
+        text = lineEnd + 1;
+    }
+
+    return true;
+}
+
+/*
+    Parses the road map and the three route maps found in `root` into one
+    multimodal graph, on `threads` threads (0 = one per hardware thread).
+
+    Every file is cut into line-aligned chunks (the road map into several,
+    the small route maps stay whole) and all chunks are parsed concurrently.
+    The merge then walks the chunks in file and line order and numbers each
+    chunk's vertices in the order the chunk first met them. That is exactly
+    the order of first appearance in a single sequential pass, so vertex
+    IDs, edge order and therefore every search result are the same for any
+    thread count.
+*/
+inline bool buildGraph_from_datasets(const std::string &root, CSRGraph &graph, int threads = 0)
+{
+    const size_t MIN_CHUNK_BYTES = 64 * 1024;
+
+    const int DATASETS = 4;
+    const std::string fileNames[DATASETS] = {
+        root + "/Roadmap-Dhaka.csv",
+        root + "/Routemap-DhakaMetroRail.csv",
+        root + "/Routemap-UttaraBus.csv",
+        root + "/Routemap-BikolpoBus.csv",
+    };
+    const int modes[DATASETS] = {2, 3, 4, 5};
+
+    MappedFile mapFiles[DATASETS];
+    bool ok = true;
+
+    for (int i = 0; i < DATASETS; i++)
+    {
+        std::string error;
+        if (!mapFiles[i].open(fileNames[i], error))
+        {
+            std::cerr << "Cant open the dataset of map - " << fileNames[i] << std::endl;
+            ok = false;
+        }
+    }
+
+    if (!ok)
+        return false;
+
+    ThreadPool pool(threads);
+
+    std::vector<DatasetChunk> chunks;
+    size_t totalBytes = 0;
+
+    for (int i = 0; i < DATASETS; i++)
+    {
+        const char *fileBegin = mapFiles[i].data();
+        const char *fileEnd = fileBegin + mapFiles[i].size();
+        size_t pieces = std::max<size_t>(1, std::min<size_t>(pool.size() * 4, mapFiles[i].size() / MIN_CHUNK_BYTES));
+
+        const char *begin = fileBegin;
+        for (size_t k = 1; k <= pieces; k++)
+        {
+            // cut after the first newline past the k-th fraction of the file
+            const char *end = fileEnd;
+            if (k < pieces)
+            {
+                const char *cut = std::max(begin, fileBegin + mapFiles[i].size() * k / pieces);
+                const char *newline = (const char *)memchr(cut, '\n', fileEnd - cut);
+                end = newline ? newline + 1 : fileEnd;
+            }
+
+            if (begin < end)
+            {
+                chunks.emplace_back();
+                DatasetChunk &chunk = chunks.back();
+                chunk.fileName = &fileNames[i];
+                chunk.fileBegin = fileBegin;
+                chunk.begin = begin;
+                chunk.end = end;
+                chunk.mode = modes[i];
+            }
+            begin = end;
+        }
+        totalBytes += mapFiles[i].size();
+    }
+
+    for (DatasetChunk &chunk : chunks)
+        pool.submit([&chunk] { parseDatasetChunk(chunk); });
+    pool.wait();
+
+    for (const DatasetChunk &chunk : chunks)
+    {
+        if (!chunk.error.empty())
+        {
+            std::cerr << chunk.error << std::endl;
+            return false;
+        }
+    }
+
+    CoordinateTable nodeMap;
+    nodeMap.reserve(totalBytes / 20);
+
+    std::vector<std::pair<double, double>> vertices(1); // 1-based index
+    std::vector<GraphEdge> edges;
+
+    size_t edgeCount = 0;
+    for (const DatasetChunk &chunk : chunks)
+        edgeCount += chunk.edges.size();
+    edges.reserve(edgeCount);
+
+    std::vector<int> globalID;
+    for (const DatasetChunk &chunk : chunks)
+    {
+        globalID.assign(chunk.vertices.size(), 0);
+        for (int v = 1; v < (int)chunk.vertices.size(); v++)
+            globalID[v] = getVertexID(nodeMap, vertices, chunk.vertices[v]);
+
+        for (const GraphEdge &edge : chunk.edges)
+            edges.push_back({globalID[edge.from], globalID[edge.to], edge.length, edge.mode});
+    }
+
+    graph = CSRGraph(vertices, edges);
+    return true;
+}
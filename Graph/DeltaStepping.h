@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "ThreadPool.h"
+
+/*
+    Delta-stepping: a one-to-all search that relaxes many vertices at once,
+    for whole shortest path trees (isochrones, coverage) where a single
+    Dijkstra keeps one core busy.
+
+    Vertices wait in buckets of width delta by cost. The lowest bucket is
+    emptied in rounds: all its vertices relax their light edges (weight up
+    to delta) in parallel, which may refill the same bucket, until it stays
+    empty; then every vertex it settled relaxes its heavy edges once, those
+    can only reach later buckets. A vertex's cost and parent are changed
+    together under a per-vertex spin lock, so the result is the least cost
+    over the same sums Dijkstra takes, the same doubles, and the parents
+    form a tree even over the zero-fare walking edges.
+
+    Only the problems without a timetable, the timed ones go to dijkstra()
+    from their starting time.
+*/
+
+// Bucket width as this many average edge costs of the problem
+const double DELTA_EDGES = 8;
+
+// Rounds with fewer vertices than this are relaxed on the calling thread
+const int DELTA_PARALLEL_FRONTIER = 256;
+
+// Average cost of the edges the problem may use, the scale for delta
+inline double averageEdgeWeight(const ProblemSpec &problem, const CSRGraph &graph)
+{
+    double sum = 0;
+    long long count = 0;
+    for (int e = 0; e < graph.edgeCount(); e++)
+    {
+        int mode = graph.mode[e];
+        if (problem.modes >> mode & 1)
+        {
+            sum += edgeWeight(problem, graph.length[e], mode);
+            count++;
+        }
+    }
+    return count ? sum / count : 1;
+}
+
+class DeltaStepping
+{
+public:
+    DeltaStepping(const ProblemSpec &problem, const QueryGraph &graph, ThreadPool &pool, double delta)
+        : problem(problem), graph(graph), pool(pool), delta(delta), vertices(graph.vertexCount()),
+          cost(new std::atomic<double>[vertices]), locked(new std::atomic<bool>[vertices]), queuedIn(new std::atomic<int>[vertices]),
+          prev(vertices, -1), prevEdge(vertices, -1), settledIn(vertices, -1)
+    {
+        for (int v = 0; v < vertices; v++)
+        {
+            cost[v].store(INT_MAX, std::memory_order_relaxed);
+            locked[v].store(false, std::memory_order_relaxed);
+            queuedIn[v].store(-1, std::memory_order_relaxed);
+        }
+    }
+
+    int run(int src, SearchContext &nodes)
+    {
+        cost[src].store(0);
+        insert(src, 0);
+
+        int settled = 0;
+        std::vector<int> frontier, round;
+        for (size_t b = 0; b < buckets.size(); b++)
+        {
+            round.clear();
+            while (!buckets[b].empty())
+            {
+                // a vertex sits in the bucket of its cost, entries left by a cost that has dropped since are stale
+                frontier.clear();
+                frontier.swap(buckets[b]);
+                for (int v : frontier)
+                    queuedIn[v].store(-1, std::memory_order_relaxed);
+                frontier.erase(std::remove_if(frontier.begin(), frontier.end(), [&](int v) { return bucketOf(cost[v].load()) != b; }),
+                               frontier.end());
+
+                for (int v : frontier)
+                    if (settledIn[v] != (int)b)
+                    {
+                        settledIn[v] = b;
+                        round.push_back(v);
+                    }
+                settled += frontier.size();
+
+                relaxAll(frontier, true);
+            }
+            relaxAll(round, false);
+        }
+
+        writeNodes(nodes);
+        return settled;
+    }
+
+private:
+    const ProblemSpec &problem;
+    const QueryGraph &graph;
+    ThreadPool &pool;
+    double delta;
+    int vertices;
+
+    std::unique_ptr<std::atomic<double>[]> cost;
+    std::unique_ptr<std::atomic<bool>[]> locked;  // held while cost, prev and prevEdge of v change
+    std::unique_ptr<std::atomic<int>[]> queuedIn; // bucket v was last queued in, -1 once taken out
+    std::vector<int> prev;
+    std::vector<int> prevEdge;
+    std::vector<int> settledIn; // last bucket whose round settled v
+    std::vector<std::vector<int>> buckets;
+
+    size_t bucketOf(double c) const
+    {
+        return (size_t)(c / delta);
+    }
+
+    void insert(int v, size_t b)
+    {
+        if (buckets.size() <= b)
+            buckets.resize(b + 1);
+        buckets[b].push_back(v);
+    }
+
+    // relaxes the light or the heavy edges of every vertex in `list`, queueing the vertices that improved
+    void relaxAll(const std::vector<int> &list, bool light)
+    {
+        if ((int)list.size() < DELTA_PARALLEL_FRONTIER || pool.size() == 1)
+        {
+            std::vector<std::pair<int, size_t>> queued;
+            for (int v : list)
+                relax(v, light, queued);
+            for (const std::pair<int, size_t> &entry : queued)
+                insert(entry.first, entry.second);
+            return;
+        }
+
+        int chunks = std::min((int)list.size(), pool.size() * 4);
+        std::vector<std::vector<std::pair<int, size_t>>> queued(chunks);
+        for (int c = 0; c < chunks; c++)
+        {
+            pool.submit([&, c, chunks] {
+                for (int i = c; i < (int)list.size(); i += chunks)
+                    relax(list[i], light, queued[c]);
+            });
+        }
+        pool.wait();
+
+        for (const std::vector<std::pair<int, size_t>> &chunk : queued)
+            for (const std::pair<int, size_t> &entry : chunk)
+                insert(entry.first, entry.second);
+    }
+
+    void relax(int v, bool light, std::vector<std::pair<int, size_t>> &queued)
+    {
+        double cost_v = cost[v].load();
+        for (int e : graph.edges(v))
+        {
+            int mode = graph.mode(e);
+            if (!(problem.modes >> mode & 1))
+                continue;
+
+            double weight = edgeWeight(problem, graph.length(e), mode);
+            if ((weight <= delta) != light)
+                continue;
+
+            int u = graph.target(e);
+            double newCost = cost_v + weight;
+            if (newCost >= cost[u].load(std::memory_order_relaxed))
+                continue;
+
+            while (locked[u].exchange(true, std::memory_order_acquire))
+                ;
+            bool improved = newCost < cost[u].load(std::memory_order_relaxed);
+            if (improved)
+            {
+                cost[u].store(newCost, std::memory_order_relaxed);
+                prev[u] = v;
+                prevEdge[u] = e;
+            }
+            locked[u].store(false, std::memory_order_release);
+            if (!improved)
+                continue;
+
+            size_t b = bucketOf(newCost);
+            if (queuedIn[u].exchange(b) != (int)b)
+                queued.push_back({u, b});
+        }
+    }
+
+    // costs and parents into `nodes` as dijkstra() leaves them, between equally cheap parents the choice may differ
+    void writeNodes(SearchContext &nodes) const
+    {
+        nodes.reset(vertices);
+        for (int v = 1; v < vertices; v++)
+        {
+            double c = cost[v].load(std::memory_order_relaxed);
+            if (c == INT_MAX)
+                continue;
+
+            nodes[v].cost = c;
+            nodes[v].prev = prev[v];
+            nodes[v].prevEdge = prevEdge[v];
+            nodes[v].arrivalTime = 0;
+        }
+    }
+};
+
+/*
+    Shortest paths from src to every node, as dijkstra() gives them, with
+    the relaxations spread over `pool`. `startingTime` and `scheduledTime`
+    as in dijkstra(), for the timed problems. `delta` 0 picks DELTA_EDGES
+    average edge costs. Returns the number of vertices relaxed, more than
+    dijkstra() settles since a vertex may be relaxed again within its bucket.
+*/
+template <class Queue = QuadHeap>
+inline int deltaStepping(const ProblemSpec &problem, int src, SearchContext &nodes, const QueryGraph &graph, ThreadPool &pool,
+                         double startingTime = 0, double scheduledTime = std::numeric_limits<double>::infinity(), double delta = 0)
+{
+    if (problem.timed)
+        return dijkstra<Queue>(problem, src, nodes, graph, startingTime, scheduledTime);
+
+    if (delta <= 0)
+        delta = DELTA_EDGES * averageEdgeWeight(problem, graph.graph);
+
+    return DeltaStepping(problem, graph, pool, delta).run(src, nodes);
+}
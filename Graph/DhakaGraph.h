@@ -0,0 +1,51 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "AStar.h"
+#include "Bidirectional.h"
+#include "CSRGraph.h"
+#include "Clock.h"
+#include "ContractionHierarchy.h"
+#include "Customizable.h"
+#include "Dataset.h"
+#include "Geo.h"
+#include "HubLabels.h"
+#include "KML.h"
+#include "Landmarks.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "Snapshot.h"
+
+/*
+    Loads the multimodal Dhaka graph (road map, metro rail, Uttara bus and
+    Bikolpo bus) from `root`. The snapshot written by graph-compile is used
+    when there is a valid one, otherwise the CSV files are parsed. Only the
+    snapshot brings ALT landmark tables, the (customizable) Contraction
+    Hierarchies and hub labels.
+*/
+inline bool loadDhakaGraph(CSRGraph &graph, const std::string &root = "..")
+{
+    std::string snapshotPath = root + "/Dhaka.graph";
+    std::string error;
+
+    std::shared_ptr<const Snapshot> snapshot = Snapshot::open(snapshotPath, error);
+    if (snapshot && readGraphSections(snapshot, graph, error))
+    {
+        if (!readLandmarkSections(snapshot, graph, error) && !error.empty())
+            std::cerr << "Ignoring the landmarks in " << snapshotPath << " (" << error << ")" << std::endl;
+        if (!readHierarchySections(snapshot, graph, error) && !error.empty())
+            std::cerr << "Ignoring the hierarchies in " << snapshotPath << " (" << error << ")" << std::endl;
+        if (!readCustomizableSections(snapshot, graph, error) && !error.empty())
+            std::cerr << "Ignoring the customizable hierarchy in " << snapshotPath << " (" << error << ")" << std::endl;
+        if (!readHubLabelSections(snapshot, graph, error) && !error.empty())
+            std::cerr << "Ignoring the hub labels in " << snapshotPath << " (" << error << ")" << std::endl;
+        return true;
+    }
+
+    if (error != "missing")
+        std::cerr << "Ignoring " << snapshotPath << " (" << error << "), reading the CSV files" << std::endl;
+
+    return buildGraph_from_datasets(root, graph);
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "ContractionHierarchy.h"
+#include "DeltaStepping.h"
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "ThreadPool.h"
+
+/*
+    Many-to-many: the cost from every source to every target in one go,
+    for a dispatcher that needs the whole table rather than single routes.
+
+    With a hierarchy for the problem (1-3) it is the bucket method: one
+    upward search from every target leaves (target, cost) in a bucket at
+    each vertex it settles, then one upward search from every source reads
+    the buckets of the vertices it settles. Up and down meet at the top,
+    so every pair is found by N + M small searches instead of N * M
+    queries. Timed problems, and graphs without a hierarchy, run one
+    Dijkstra per source that stops when every target is settled.
+
+    One-to-all (oneToAllMatrix) has every graph vertex as a target, whole
+    shortest path trees for isochrones and coverage: one delta-stepping
+    search per source spread over a thread pool, no buckets.
+
+    All points are snapped onto one query overlay the way QueryGraph does
+    for a single query, except that a target may land on the same vertex
+    as a source (a single query steers the destination off the source).
+*/
+struct DistanceMatrix
+{
+    int rows = 0;
+    int columns = 0;
+    std::vector<double> values; // row major, INT_MAX where there is no path
+
+    double at(int source, int target) const
+    {
+        return values[(size_t)source * columns + target];
+    }
+};
+
+/*
+    The value kept per pair is what the problem minimises: km for Problem
+    1, Tk for the fare problems, and for Problem 5 the minutes travelled
+    since `startingTime` rather than the clock time of arrival.
+*/
+inline double matrixValue(const ProblemSpec &problem, const Node &node, double startingTime)
+{
+    if (node.cost == INT_MAX)
+        return INT_MAX;
+    if (problem.objective == MIN_ARRIVAL)
+        return node.arrivalTime - startingTime;
+    return node.cost;
+}
+
+// Target of an upward search, as left at a vertex it settled
+struct BucketEntry
+{
+    int vertex;
+    int column;
+    double cost;
+};
+
+// Fills `matrix` over one metric of a hierarchy, sources and targets already on the overlay (-1 for a point not snapped)
+template <class Queue = QuadHeap>
+inline void bucketMatrix(const ProblemSpec &problem, const ContractionHierarchy &hierarchy, int metric, const std::vector<int> &sourceIDs,
+                         const std::vector<int> &targetIDs, const QueryGraph &query, DistanceMatrix &matrix)
+{
+    int base = query.graph.vertexCount();
+    const int *first = hierarchy.offsets(metric);
+
+    HierarchySide<Queue> side;
+    side.reset(base);
+
+    // every target's upward search space, and its overlay labels for pairs that meet before the graph
+    std::vector<BucketEntry> entries;
+    std::vector<std::vector<OverlayLabel>> targetLabels(targetIDs.size());
+    for (int j = 0; j < (int)targetIDs.size(); j++)
+    {
+        if (targetIDs[j] == -1)
+            continue;
+
+        labelOverlay(problem, targetIDs[j], query, targetLabels[j]);
+
+        side.reset(base);
+        for (const OverlayLabel &label : targetLabels[j])
+            if (label.vertex < base)
+                side.label(label.vertex, label.cost, -1, -1);
+
+        while (!side.queue.empty())
+        {
+            int v = side.queue.pop().second;
+            entries.push_back({v, j, side.cost[v]});
+
+            for (int a = first[v]; a < first[v + 1]; a++)
+            {
+                int u = hierarchy.target[a];
+                double cost = side.cost[v] + hierarchy.weight[a];
+                if (cost < side.cost[u])
+                    side.label(u, cost, v, a);
+            }
+        }
+    }
+
+    // buckets as one array sorted by vertex
+    std::vector<int> bucket(base + 1, 0);
+    for (const BucketEntry &entry : entries)
+        bucket[entry.vertex + 1]++;
+    for (int v = 0; v < base; v++)
+        bucket[v + 1] += bucket[v];
+
+    std::vector<BucketEntry> sorted(entries.size());
+    std::vector<int> fill(bucket.begin(), bucket.end() - 1);
+    for (const BucketEntry &entry : entries)
+        sorted[fill[entry.vertex]++] = entry;
+    entries.clear();
+
+    std::vector<OverlayLabel> labels;
+    for (int i = 0; i < (int)sourceIDs.size(); i++)
+    {
+        if (sourceIDs[i] == -1)
+            continue;
+
+        double *row = matrix.values.data() + (size_t)i * matrix.columns;
+        labelOverlay(problem, sourceIDs[i], query, labels);
+
+        for (const OverlayLabel &label : labels)
+        {
+            if (label.vertex < base)
+                continue;
+            for (int j = 0; j < (int)targetIDs.size(); j++)
+            {
+                int at = findLabel(targetLabels[j], label.vertex);
+                if (at != -1)
+                    row[j] = std::min(row[j], label.cost + targetLabels[j][at].cost);
+            }
+        }
+
+        side.reset(base);
+        for (const OverlayLabel &label : labels)
+            if (label.vertex < base)
+                side.label(label.vertex, label.cost, -1, -1);
+
+        while (!side.queue.empty())
+        {
+            int v = side.queue.pop().second;
+            double cost_v = side.cost[v];
+
+            for (int b = bucket[v]; b < bucket[v + 1]; b++)
+                row[sorted[b].column] = std::min(row[sorted[b].column], cost_v + sorted[b].cost);
+
+            for (int a = first[v]; a < first[v + 1]; a++)
+            {
+                int u = hierarchy.target[a];
+                double cost = cost_v + hierarchy.weight[a];
+                if (cost < side.cost[u])
+                    side.label(u, cost, v, a);
+            }
+        }
+    }
+}
+
+/*
+    Costs from every source to every target coordinate for `problem`
+    (`startingTime` and `scheduledTime` as in dijkstraTo(), timed problems
+    only). A point that cannot be snapped onto the problem's modes gets a
+    row or column without paths.
+*/
+template <class Queue = QuadHeap>
+inline DistanceMatrix distanceMatrix(const ProblemSpec &problem, const std::vector<std::pair<double, double>> &sources,
+                                     const std::vector<std::pair<double, double>> &targets, const CSRGraph &graph,
+                                     double startingTime = 0, double scheduledTime = std::numeric_limits<double>::infinity())
+{
+    DistanceMatrix matrix;
+    matrix.rows = sources.size();
+    matrix.columns = targets.size();
+    matrix.values.assign((size_t)matrix.rows * matrix.columns, INT_MAX);
+
+    QueryGraph query(graph);
+    std::vector<int> sourceIDs, targetIDs;
+    for (const std::pair<double, double> &lonLat : sources)
+        sourceIDs.push_back(query.attach(lonLat, problem.modes));
+    for (const std::pair<double, double> &lonLat : targets)
+        targetIDs.push_back(query.attach(lonLat, problem.modes));
+
+    const ContractionHierarchy *hierarchy = graph.hierarchy.get();
+    int metric = hierarchy && !problem.timed ? hierarchy->metricOf(problem.number) : -1;
+    if (metric != -1)
+    {
+        bucketMatrix<Queue>(problem, *hierarchy, metric, sourceIDs, targetIDs, query, matrix);
+        return matrix;
+    }
+
+    std::vector<int> reachable;
+    for (int id : targetIDs)
+        if (id != -1)
+            reachable.push_back(id);
+
+    SearchContext nodes;
+    for (int i = 0; i < matrix.rows && !reachable.empty(); i++)
+    {
+        if (sourceIDs[i] == -1)
+            continue;
+
+        dijkstraTo<Queue>(problem, sourceIDs[i], reachable, nodes, query, startingTime, scheduledTime);
+        for (int j = 0; j < matrix.columns; j++)
+            if (targetIDs[j] != -1)
+                matrix.values[(size_t)i * matrix.columns + j] = matrixValue(problem, nodes[targetIDs[j]], startingTime);
+    }
+    return matrix;
+}
+
+/*
+    Values from every source to every graph vertex, column v being vertex v
+    (column 0, no vertex, stays empty), by deltaStepping() on `pool` (the
+    timed problems fall back to dijkstra() from `startingTime`). Holds rows x
+    vertices values, about 0.4 MB per source.
+*/
+template <class Queue = QuadHeap>
+inline DistanceMatrix oneToAllMatrix(const ProblemSpec &problem, const std::vector<std::pair<double, double>> &sources, const CSRGraph &graph,
+                                     ThreadPool &pool, double startingTime = 0,
+                                     double scheduledTime = std::numeric_limits<double>::infinity())
+{
+    DistanceMatrix matrix;
+    matrix.rows = sources.size();
+    matrix.columns = graph.vertexCount();
+    matrix.values.assign((size_t)matrix.rows * matrix.columns, INT_MAX);
+
+    QueryGraph query(graph);
+    std::vector<int> sourceIDs;
+    for (const std::pair<double, double> &lonLat : sources)
+        sourceIDs.push_back(query.attach(lonLat, problem.modes));
+
+    SearchContext nodes;
+    for (int i = 0; i < matrix.rows; i++)
+    {
+        if (sourceIDs[i] == -1)
+            continue;
+
+        deltaStepping<Queue>(problem, sourceIDs[i], nodes, query, pool, startingTime, scheduledTime);
+
+        for (int v = 1; v < matrix.columns; v++)
+            matrix.values[(size_t)i * matrix.columns + v] = matrixValue(problem, nodes[v], startingTime);
+    }
+    return matrix;
+}
+
+// One line per source, the targets' values separated by commas, empty where there is no path
+inline bool writeMatrixCSV(std::ostream &out, const DistanceMatrix &matrix)
+{
+    char number[64];
+    for (int i = 0; i < matrix.rows; i++)
+    {
+        for (int j = 0; j < matrix.columns; j++)
+        {
+            if (j)
+                out << ',';
+            if (matrix.at(i, j) != INT_MAX)
+            {
+                snprintf(number, sizeof(number), "%.6f", matrix.at(i, j));
+                out << number;
+            }
+        }
+        out << '\n';
+    }
+    return (bool)out.flush();
+}
+
+/*
+    Binary matrix: int32 rows, int32 columns, then rows * columns float64
+    values row by row, +infinity where there is no path. Native byte order,
+    like the snapshot.
+*/
+inline bool writeMatrixBinary(std::ostream &out, const DistanceMatrix &matrix)
+{
+    int32_t size[2] = {matrix.rows, matrix.columns};
+    out.write((const char *)size, sizeof(size));
+
+    std::vector<double> row(matrix.columns);
+    for (int i = 0; i < matrix.rows; i++)
+    {
+        for (int j = 0; j < matrix.columns; j++)
+            row[j] = matrix.at(i, j) == INT_MAX ? std::numeric_limits<double>::infinity() : matrix.at(i, j);
+        out.write((const char *)row.data(), row.size() * sizeof(double));
+    }
+    return (bool)out.flush();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <utility>
+
+// Function to calculate distance using Haversine formula
+inline double haversine(std::pair<double, double> lon_lat1, std::pair<double, double> lon_lat2)
+{
+    const double R = 6371.0;
+
+    double lon1_rad = lon_lat1.first * M_PI / 180.0;
+    double lat1_rad = lon_lat1.second * M_PI / 180.0;
+    double lon2_rad = lon_lat2.first * M_PI / 180.0;
+    double lat2_rad = lon_lat2.second * M_PI / 180.0;
+
+    double dlat = lat2_rad - lat1_rad;
+    double dlon = lon2_rad - lon1_rad;
+
+    double a = sin(dlat / 2) * sin(dlat / 2) +
+               cos(lat1_rad) * cos(lat2_rad) * sin(dlon / 2) * sin(dlon / 2);
+    double c = 2 * atan2(sqrt(a), sqrt(1 - a));
+
+    double distance = R * c;
+    return distance;
+}
+
+/*
+    Position of the point of segment a-b closest to p, as the fraction t of
+    the way from a to b (0 at a, 1 at b). Computed on a flat projection
+    around p, which is exact enough over the length of a road segment.
+*/
+inline double projectOnSegment(std::pair<double, double> p, std::pair<double, double> a, std::pair<double, double> b)
+{
+    double scale = cos(p.second * M_PI / 180.0);
+
+    double ax = (a.first - p.first) * scale, ay = a.second - p.second;
+    double bx = (b.first - p.first) * scale, by = b.second - p.second;
+
+    double dx = bx - ax, dy = by - ay;
+    double length2 = dx * dx + dy * dy;
+    if (length2 == 0)
+        return 0;
+
+    double t = -(ax * dx + ay * dy) / length2;
+    return t < 0 ? 0 : t > 1 ? 1 : t;
+}
+
+// The point a fraction t of the way from a to b
+inline std::pair<double, double> interpolate(std::pair<double, double> a, std::pair<double, double> b, double t)
+{
+    return {a.first + (b.first - a.first) * t, a.second + (b.second - a.second) * t};
+}
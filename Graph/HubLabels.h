@@ -0,0 +1,460 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "ContractionHierarchy.h"
+#include "Landmarks.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+/*
+    Hub labels: a distance oracle read off a Contraction Hierarchy.
+
+    The label of v lists hubs h with the cost from v to h over upward arcs.
+    Every shortest path climbs to its highest vertex and descends, so that
+    vertex is a hub of both ends, and
+
+        cost(s, t) = min over hubs h of s and t of  cost(s, h) + cost(h, t)
+
+    which is a merge of two sorted arrays, no search at all. The graph has
+    every edge both ways with the same cost, so one label per vertex serves
+    both ends.
+
+    Labels are built top-down: a vertex takes the labels of its upward
+    neighbours plus the arc to them, then drops hubs that the labels
+    already reach cheaper some other way. That keeps them to about a
+    hundred hubs. Each entry also keeps the neighbour it came through, so
+    the path to a hub can be walked and unpacked when it is wanted.
+
+    Hubs and costs are separate flat arrays. A label starts on a 64 byte
+    line (the snapshot aligns sections to 64 bytes) and is padded with
+    INT_MAX hubs to a whole number of lines, at least one pad each, so the
+    merge runs without bounds checks and always ends on a pair of pads.
+*/
+struct HubLabels
+{
+    int metrics = 0;
+    int vertices = 0;
+    size_t entries = 0;
+
+    const int *problem = nullptr;          // [metrics]
+    const uint64_t *fingerprint = nullptr; // [metrics], metricFingerprint() when built
+    const int64_t *offset = nullptr;       // [metric * (vertices + 1) + v], label of v is the entries offset .. next offset - 1
+    const int *hub = nullptr;              // [entries], ascending, then INT_MAX pads
+    const double *cost = nullptr;          // [entries]
+    const int *parent = nullptr;           // [entries], upward neighbour the hub is reached through, -1 for v itself
+
+    std::shared_ptr<const void> storage;
+
+    // labels for a problem, -1 when it has none or its costs changed since
+    int metricOf(int number) const
+    {
+        for (int m = 0; m < metrics; m++)
+            if (problem[m] == number && fingerprint[m] == metricFingerprint(problemSpec(number)))
+                return m;
+        return -1;
+    }
+
+    int64_t labelOf(int metric, int v) const
+    {
+        return offset[(size_t)metric * (vertices + 1) + v];
+    }
+
+    // cost between two graph vertices and the hub it goes through, (INT_MAX, -1) when there is no path
+    std::pair<double, int> distance(int metric, int s, int t) const
+    {
+        const int *a = hub + labelOf(metric, s), *b = hub + labelOf(metric, t);
+        const double *aCost = cost + labelOf(metric, s), *bCost = cost + labelOf(metric, t);
+
+        std::pair<double, int> best = {INT_MAX, -1};
+        size_t i = 0, j = 0;
+        while (true)
+        {
+            if (a[i] == b[j])
+            {
+                if (a[i] == INT_MAX)
+                    break;
+                double through = aCost[i] + bCost[j];
+                if (through < best.first)
+                    best = {through, a[i]};
+                i++;
+                j++;
+            }
+            else if (a[i] < b[j])
+                i++;
+            else
+                j++;
+        }
+        return best;
+    }
+
+    // slot of hub h in the label of v, -1 when it is not there
+    int64_t find(int metric, int v, int h) const
+    {
+        int64_t begin = labelOf(metric, v), end = labelOf(metric, v + 1);
+        const int *at = std::lower_bound(hub + begin, hub + end, h);
+        return at != hub + end && *at == h ? at - hub : -1;
+    }
+
+    // appends the graph vertices after v on the way up to hub h, h last
+    void pathToHub(const ContractionHierarchy &hierarchy, int hierarchyMetric, int metric, int v, int h, std::vector<int> &path) const
+    {
+        const int *first = hierarchy.offsets(hierarchyMetric);
+        for (int x = v; x != h;)
+        {
+            int next = parent[find(metric, x, h)];
+
+            int arc = first[x];
+            while (hierarchy.target[arc] != next)
+                arc++;
+            hierarchy.unpack(hierarchyMetric, arc, x, next, path);
+            x = next;
+        }
+    }
+};
+
+// hubs per label are padded to a multiple of this, 64 bytes of hub IDs
+const int HUB_LINE = 16;
+
+// distance queries only: labels for the fare problems would make the snapshot (and its checksum at every start) three times larger
+const std::vector<int> HUB_LABEL_PROBLEMS = {1};
+
+// a hub is only dropped when clearly beaten, not over a rounding difference between two equal paths
+const double HUB_SLACK = 1e-9;
+
+/*
+    Labels for the given problems' metrics of `hierarchy` (graph.hierarchy).
+    A vertex only needs the labels of vertices above it, so vertices are
+    taken a height at a time from the top and each height is labelled in
+    parallel.
+*/
+inline std::shared_ptr<const HubLabels> buildHubLabels(const ContractionHierarchy &hierarchy, const std::vector<int> &problems, int threads = 0)
+{
+    struct Tables
+    {
+        std::vector<int> problem;
+        std::vector<uint64_t> fingerprint;
+        std::vector<int64_t> offset;
+        std::vector<int> hub;
+        std::vector<double> cost;
+        std::vector<int> parent;
+    };
+    auto tables = std::make_shared<Tables>();
+
+    struct Entry
+    {
+        int hub;
+        double cost;
+        int parent;
+    };
+
+    ThreadPool pool(threads);
+    int vertices = hierarchy.vertices;
+
+    for (int number : problems)
+    {
+        int m = hierarchy.metricOf(number);
+        if (m == -1)
+            continue;
+        const int *first = hierarchy.offsets(m);
+
+        // height: 0 without upward arcs, else one more than the highest neighbour above
+        std::vector<int> height(vertices, -1), stack;
+        for (int root = 0; root < vertices; root++)
+        {
+            stack.push_back(root);
+            while (!stack.empty())
+            {
+                int v = stack.back();
+                if (height[v] != -1)
+                {
+                    stack.pop_back();
+                    continue;
+                }
+
+                bool ready = true;
+                int h = 0;
+                for (int a = first[v]; a < first[v + 1]; a++)
+                {
+                    int u = hierarchy.target[a];
+                    if (height[u] == -1)
+                    {
+                        stack.push_back(u);
+                        ready = false;
+                    }
+                    else
+                        h = std::max(h, height[u] + 1);
+                }
+                if (ready)
+                {
+                    height[v] = h;
+                    stack.pop_back();
+                }
+            }
+        }
+
+        std::vector<std::vector<int>> byHeight;
+        for (int v = 0; v < vertices; v++)
+        {
+            if (height[v] >= (int)byHeight.size())
+                byHeight.resize(height[v] + 1);
+            byHeight[height[v]].push_back(v);
+        }
+
+        std::vector<std::vector<Entry>> labels(vertices);
+        for (const std::vector<int> &level : byHeight)
+        {
+            int chunks = std::min((int)level.size(), pool.size() * 4);
+            for (int c = 0; c < chunks; c++)
+            {
+                pool.submit([&, c, chunks] {
+                    std::vector<double> costTo(vertices, std::numeric_limits<double>::infinity()); // label being built, by hub
+                    std::vector<Entry> candidates;
+
+                    for (size_t i = c; i < level.size(); i += chunks)
+                    {
+                        int v = level[i];
+                        candidates.assign(1, {v, 0, -1});
+                        for (int a = first[v]; a < first[v + 1]; a++)
+                            for (const Entry &entry : labels[hierarchy.target[a]])
+                                candidates.push_back({entry.hub, entry.cost + hierarchy.weight[a], hierarchy.target[a]});
+
+                        std::stable_sort(candidates.begin(), candidates.end(), [](const Entry &x, const Entry &y) {
+                            return x.hub < y.hub || (x.hub == y.hub && x.cost < y.cost);
+                        });
+                        candidates.erase(std::unique(candidates.begin(), candidates.end(), [](const Entry &x, const Entry &y) { return x.hub == y.hub; }),
+                                         candidates.end());
+
+                        for (const Entry &entry : candidates)
+                            costTo[entry.hub] = entry.cost;
+
+                        // a hub reached cheaper through another hub is not on a shortest path
+                        std::vector<Entry> &label = labels[v];
+                        for (const Entry &entry : candidates)
+                        {
+                            bool needed = true;
+                            if (entry.hub != v)
+                                for (const Entry &other : labels[entry.hub])
+                                    if (costTo[other.hub] + other.cost < entry.cost * (1 - HUB_SLACK))
+                                    {
+                                        needed = false;
+                                        break;
+                                    }
+                            if (needed)
+                                label.push_back(entry);
+                        }
+
+                        for (const Entry &entry : candidates)
+                            costTo[entry.hub] = std::numeric_limits<double>::infinity();
+                    }
+                });
+            }
+            pool.wait();
+        }
+
+        tables->problem.push_back(hierarchy.problem[m]);
+        tables->fingerprint.push_back(hierarchy.fingerprint[m]);
+        for (int v = 0; v < vertices; v++)
+        {
+            tables->offset.push_back(tables->hub.size());
+            for (const Entry &entry : labels[v])
+            {
+                tables->hub.push_back(entry.hub);
+                tables->cost.push_back(entry.cost);
+                tables->parent.push_back(entry.parent);
+            }
+            do
+            {
+                tables->hub.push_back(INT_MAX);
+                tables->cost.push_back(std::numeric_limits<double>::infinity());
+                tables->parent.push_back(-1);
+            } while (tables->hub.size() % HUB_LINE);
+        }
+        tables->offset.push_back(tables->hub.size());
+    }
+
+    auto hubs = std::make_shared<HubLabels>();
+    hubs->metrics = tables->problem.size();
+    hubs->vertices = vertices;
+    hubs->entries = tables->hub.size();
+    hubs->problem = tables->problem.data();
+    hubs->fingerprint = tables->fingerprint.data();
+    hubs->offset = tables->offset.data();
+    hubs->hub = tables->hub.data();
+    hubs->cost = tables->cost.data();
+    hubs->parent = tables->parent.data();
+    hubs->storage = tables;
+    return hubs;
+}
+
+inline void addHubLabelSections(SnapshotWriter &writer, const HubLabels &hubs)
+{
+    writer.add(SECTION_HUB_PROBLEMS, hubs.problem, hubs.metrics);
+    writer.add(SECTION_HUB_TABLES, hubs.fingerprint, hubs.metrics);
+    writer.add(SECTION_HUB_OFFSET, hubs.offset, (size_t)hubs.metrics * (hubs.vertices + 1));
+    writer.add(SECTION_HUB_HUB, hubs.hub, hubs.entries);
+    writer.add(SECTION_HUB_COST, hubs.cost, hubs.entries);
+    writer.add(SECTION_HUB_PARENT, hubs.parent, hubs.entries);
+}
+
+// Points graph.hubLabels into the mapped snapshot, false with an empty error when it has none
+inline bool readHubLabelSections(const std::shared_ptr<const Snapshot> &snapshot, CSRGraph &graph, std::string &error)
+{
+    size_t metrics, fingerprints, offsets, hubCount, costs, parents;
+    auto hubs = std::make_shared<HubLabels>();
+
+    hubs->problem = snapshot->section<int>(SECTION_HUB_PROBLEMS, metrics);
+    hubs->fingerprint = snapshot->section<uint64_t>(SECTION_HUB_TABLES, fingerprints);
+    hubs->offset = snapshot->section<int64_t>(SECTION_HUB_OFFSET, offsets);
+    hubs->hub = snapshot->section<int>(SECTION_HUB_HUB, hubCount);
+    hubs->cost = snapshot->section<double>(SECTION_HUB_COST, costs);
+    hubs->parent = snapshot->section<int>(SECTION_HUB_PARENT, parents);
+
+    error = "";
+    if (!hubs->problem && !hubs->fingerprint && !hubs->offset && !hubs->hub && !hubs->cost && !hubs->parent)
+        return false;
+
+    int vertices = graph.vertexCount();
+    if (!hubs->problem || !hubs->fingerprint || !hubs->offset || !hubs->hub || !hubs->cost || !hubs->parent ||
+        metrics == 0 || fingerprints != metrics || offsets != metrics * (vertices + 1) || costs != hubCount || parents != hubCount)
+    {
+        error = "hub label sections are missing or inconsistent";
+        return false;
+    }
+
+    // every label must end in a pad inside the arrays, or a merge would run off them
+    for (size_t m = 0; m < metrics; m++)
+        for (int v = 0; v < vertices; v++)
+        {
+            int64_t begin = hubs->offset[m * (vertices + 1) + v], end = hubs->offset[m * (vertices + 1) + v + 1];
+            if (begin < 0 || end <= begin || (size_t)end > hubCount || hubs->hub[end - 1] != INT_MAX)
+            {
+                error = "hub label offsets out of range";
+                return false;
+            }
+        }
+    for (size_t e = 0; e < hubCount; e++)
+        if ((hubs->hub[e] != INT_MAX && (hubs->hub[e] < 0 || hubs->hub[e] >= vertices)) || hubs->parent[e] < -1 || hubs->parent[e] >= vertices)
+        {
+            error = "hub label entry out of range";
+            return false;
+        }
+
+    hubs->metrics = metrics;
+    hubs->vertices = vertices;
+    hubs->entries = hubCount;
+    hubs->storage = snapshot;
+    graph.hubLabels = hubs;
+    return true;
+}
+
+/*
+    Cost from src to dst over the query graph for a problem with hub
+    labels, INT_MAX when dst cannot be reached, -1 when the graph has no
+    labels for the problem. Only the few labels where src and dst join the
+    graph are merged, no search runs.
+*/
+inline double hubDistance(const ProblemSpec &problem, int src, int dst, const QueryGraph &graph)
+{
+    const HubLabels *hubs = graph.graph.hubLabels.get();
+    int metric = hubs ? hubs->metricOf(problem.number) : -1;
+    if (metric == -1)
+        return -1;
+
+    int base = graph.graph.vertexCount();
+    std::vector<OverlayLabel> fromSrc, toDst;
+    labelOverlay(problem, src, graph, fromSrc);
+    labelOverlay(problem, dst, graph, toDst);
+
+    double best = INT_MAX;
+    for (const OverlayLabel &s : fromSrc)
+        for (const OverlayLabel &t : toDst)
+        {
+            double through = s.vertex == t.vertex ? 0 : INT_MAX;
+            if (s.vertex < base && t.vertex < base && s.vertex != t.vertex)
+                through = hubs->distance(metric, s.vertex, t.vertex).first;
+            best = std::min(best, s.cost + through + t.cost);
+        }
+    return best;
+}
+
+/*
+    Route from src to dst through the hub labels, written to `nodes` the
+    way dijkstraTo() writes it. The hubs give the best pair of graph
+    vertices and the hub between them, the path is then walked up to the
+    hub from both sides and unpacked. Needs the hierarchy the labels came
+    from; falls back to chSearch() without either. Returns the number of
+    labels merged.
+*/
+inline int hubSearch(const ProblemSpec &problem, int src, int dst, SearchContext &nodes, const QueryGraph &graph)
+{
+    const HubLabels *hubs = graph.graph.hubLabels.get();
+    const ContractionHierarchy *hierarchy = graph.graph.hierarchy.get();
+    int metric = hubs ? hubs->metricOf(problem.number) : -1;
+    int hierarchyMetric = hierarchy ? hierarchy->metricOf(problem.number) : -1;
+    if (metric == -1 || hierarchyMetric == -1)
+        return chSearch(problem, src, dst, nodes, graph);
+
+    int base = graph.graph.vertexCount();
+    nodes.reset(graph.vertexCount());
+    nodes[src].cost = 0;
+
+    std::vector<OverlayLabel> fromSrc, toDst;
+    labelOverlay(problem, src, graph, fromSrc);
+    labelOverlay(problem, dst, graph, toDst);
+
+    double best = INT_MAX;
+    int bestS = -1, bestT = -1, bestHub = -1, merged = 0;
+    for (const OverlayLabel &s : fromSrc)
+        for (const OverlayLabel &t : toDst)
+        {
+            std::pair<double, int> through = {INT_MAX, -1};
+            if (s.vertex == t.vertex)
+                through = {0, s.vertex};
+            else if (s.vertex < base && t.vertex < base)
+            {
+                through = hubs->distance(metric, s.vertex, t.vertex);
+                merged++;
+            }
+
+            if (s.cost + through.first + t.cost < best)
+            {
+                best = s.cost + through.first + t.cost;
+                bestS = s.vertex;
+                bestT = t.vertex;
+                bestHub = through.second;
+            }
+        }
+
+    if (bestS == -1)
+        return merged;
+
+    std::vector<int> path;
+    overlayChain(fromSrc, bestS, path);
+    std::reverse(path.begin(), path.end());
+    path.push_back(bestS);
+
+    if (bestS != bestT)
+    {
+        hubs->pathToHub(*hierarchy, hierarchyMetric, metric, bestS, bestHub, path);
+
+        std::vector<int> down(1, bestT);
+        hubs->pathToHub(*hierarchy, hierarchyMetric, metric, bestT, bestHub, down);
+        down.pop_back(); // the hub, already on the path
+        path.insert(path.end(), down.rbegin(), down.rend());
+    }
+    overlayChain(toDst, bestT, path);
+
+    writePath(problem, path, nodes, graph);
+    return merged;
+}
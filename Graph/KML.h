@@ -0,0 +1,53 @@
+#pragma once
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "QueryGraph.h"
+
+// Writes `path` as a red line for Google Earth, `title` becomes the document name
+inline void writeKML(const std::string &filename, const std::string &title, const std::vector<int> &path, const QueryGraph &graph)
+{
+    std::ofstream kml(filename);
+    if (!kml.is_open())
+    {
+        std::cout << "Could not write KML file" << std::endl;
+        return;
+    }
+
+    kml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    kml << "<kml xmlns=\"http://www.opengis.net/kml/2.2\">\n";
+    kml << "<Document>\n";
+    kml << "<name>" << title << "</name>\n";
+
+    kml << "<Placemark>\n";
+    kml << "<name>Route</name>\n";
+    kml << "<Style>\n";
+    kml << "<LineStyle>\n";
+    kml << "<color>ff0000ff</color>\n"; // red line (aabbggrr)
+    kml << "<width>4</width>\n";
+    kml << "</LineStyle>\n";
+    kml << "</Style>\n";
+
+    kml << "<LineString>\n";
+    kml << "<tessellate>1</tessellate>\n";
+    kml << "<coordinates>\n";
+
+    for (int id : path)
+    {
+        double lon = graph.lonLat(id).first;
+        double lat = graph.lonLat(id).second;
+        kml << lon << "," << lat << ",0\n";
+    }
+
+    kml << "</coordinates>\n";
+    kml << "</LineString>\n";
+    kml << "</Placemark>\n";
+
+    kml << "</Document>\n";
+    kml << "</kml>\n";
+
+    kml.close();
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AStar.h"
+#include "Bidirectional.h"
+#include "CSRGraph.h"
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "Snapshot.h"
+#include "ThreadPool.h"
+
+/*
+    ALT: A* with landmarks and the triangle inequality.
+
+    For each problem without a timetable (1-3, a "metric") a few landmark
+    vertices are picked and the cost from every landmark to every vertex is
+    stored. The graph has every edge both ways, so for a landmark L
+
+        cost(v, dst) >= |cost(L, dst) - cost(L, v)|
+
+    and the best of these over the landmarks is an A* potential. Unlike the
+    straight-line bound it knows about rivers, missing crossings and the
+    Tk tables, and it is not 0 for the problems where walking is free.
+
+    Tables are computed by graph-compile and stored in the snapshot, so the
+    programs map them with the graph. A table is only used while the
+    problem's costs are the ones it was measured with. Costs are floats (they are only
+    bounds), vertex-major: the landmarks of one vertex are next to each
+    other, which is all one potential evaluation reads.
+*/
+// Changes whenever a problem's edge costs do, so tables measured with other costs are not used
+inline uint64_t metricFingerprint(const ProblemSpec &problem)
+{
+    double costs[8] = {(double)problem.modes, (double)problem.objective};
+    std::copy(problem.costPerKM, problem.costPerKM + 6, costs + 2);
+    return snapshotChecksum((const unsigned char *)costs, sizeof(costs));
+}
+
+struct Landmarks
+{
+    int metrics = 0;
+    int count = 0; // landmarks per metric
+    int vertices = 0;
+
+    const int *problem = nullptr;          // [metrics]
+    const uint64_t *fingerprint = nullptr; // [metrics]
+    const int *vertex = nullptr;     // [metric * count + i]
+    const float *distance = nullptr; // [(metric * vertices + v) * count + i], infinity when unreachable
+
+    std::shared_ptr<const void> storage;
+
+    // table index for a problem, -1 when it has none or its costs changed since
+    int metricOf(int number) const
+    {
+        for (int m = 0; m < metrics; m++)
+            if (problem[m] == number && fingerprint[m] == metricFingerprint(problemSpec(number)))
+                return m;
+        return -1;
+    }
+
+    const float *distances(int metric, int v) const
+    {
+        return distance + ((size_t)metric * vertices + v) * count;
+    }
+};
+
+const int DEFAULT_LANDMARKS = 16;
+
+/*
+    Farthest selection, per metric: the first landmark is the vertex
+    farthest from the middle of the map, every next one the vertex
+    farthest from all landmarks so far. That spreads them around the edge
+    of the city, where they bound the most trips. The metrics are
+    computed in parallel.
+*/
+inline std::shared_ptr<const Landmarks> buildLandmarks(const CSRGraph &graph, int count = DEFAULT_LANDMARKS, int threads = 0)
+{
+    struct Tables
+    {
+        std::vector<int> problem;
+        std::vector<uint64_t> fingerprint;
+        std::vector<int> vertex;
+        std::vector<float> distance;
+    };
+    auto tables = std::make_shared<Tables>();
+
+    for (int number = 1; number <= PROBLEMS; number++)
+        if (!problemSpec(number).timed)
+        {
+            tables->problem.push_back(number);
+            tables->fingerprint.push_back(metricFingerprint(problemSpec(number)));
+        }
+
+    int metrics = tables->problem.size();
+    int vertices = graph.vertexCount();
+    tables->vertex.assign((size_t)metrics * count, 0);
+    tables->distance.assign((size_t)metrics * vertices * count, std::numeric_limits<float>::infinity());
+
+    std::pair<double, double> middle = {0, 0};
+    for (int v = 1; v < vertices; v++)
+    {
+        middle.first += graph.lon[v] / (vertices - 1);
+        middle.second += graph.lat[v] / (vertices - 1);
+    }
+
+    ThreadPool pool(std::min(threads > 0 ? threads : ThreadPool::defaultThreads(), metrics));
+    for (int m = 0; m < metrics; m++)
+    {
+        pool.submit([&, m] {
+            const ProblemSpec &problem = problemSpec(tables->problem[m]);
+            QueryGraph base(graph);
+            SearchContext nodes;
+
+            double ignored;
+            int seed = graph.nearestVertex(middle, problem.modes, -1, ignored);
+            if (seed == -1)
+                return;
+
+            // cost to the nearest landmark so far (from the seed before the first), INT_MAX when unreachable
+            std::vector<double> score(vertices, INT_MAX);
+            dijkstra(problem, seed, nodes, base);
+            for (int v = 1; v < vertices; v++)
+                score[v] = nodes[v].cost;
+
+            for (int i = 0; i < count; i++)
+            {
+                int landmark = seed;
+                for (int v = 1; v < vertices; v++)
+                    if (score[v] != INT_MAX && (score[landmark] == INT_MAX || score[v] > score[landmark]))
+                        landmark = v;
+                tables->vertex[(size_t)m * count + i] = landmark;
+
+                dijkstra(problem, landmark, nodes, base);
+                for (int v = 1; v < vertices; v++)
+                {
+                    if (nodes[v].cost != INT_MAX)
+                        tables->distance[((size_t)m * vertices + v) * count + i] = nodes[v].cost;
+                    score[v] = i == 0 ? nodes[v].cost : std::min(score[v], nodes[v].cost);
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    auto landmarks = std::make_shared<Landmarks>();
+    landmarks->metrics = metrics;
+    landmarks->count = count;
+    landmarks->vertices = vertices;
+    landmarks->problem = tables->problem.data();
+    landmarks->fingerprint = tables->fingerprint.data();
+    landmarks->vertex = tables->vertex.data();
+    landmarks->distance = tables->distance.data();
+    landmarks->storage = tables;
+    return landmarks;
+}
+
+inline void addLandmarkSections(SnapshotWriter &writer, const Landmarks &landmarks)
+{
+    writer.add(SECTION_LANDMARK_PROBLEMS, landmarks.problem, landmarks.metrics);
+    writer.add(SECTION_LANDMARK_TABLES, landmarks.fingerprint, landmarks.metrics);
+    writer.add(SECTION_LANDMARK_VERTICES, landmarks.vertex, (size_t)landmarks.metrics * landmarks.count);
+    writer.add(SECTION_LANDMARK_DISTANCES, landmarks.distance, (size_t)landmarks.metrics * landmarks.vertices * landmarks.count);
+}
+
+// Points graph.landmarks into the mapped snapshot, false with an empty error when it has no tables
+inline bool readLandmarkSections(const std::shared_ptr<const Snapshot> &snapshot, CSRGraph &graph, std::string &error)
+{
+    size_t metrics, fingerprints, vertices, distances;
+    auto landmarks = std::make_shared<Landmarks>();
+
+    landmarks->problem = snapshot->section<int>(SECTION_LANDMARK_PROBLEMS, metrics);
+    landmarks->fingerprint = snapshot->section<uint64_t>(SECTION_LANDMARK_TABLES, fingerprints);
+    landmarks->vertex = snapshot->section<int>(SECTION_LANDMARK_VERTICES, vertices);
+    landmarks->distance = snapshot->section<float>(SECTION_LANDMARK_DISTANCES, distances);
+
+    error = "";
+    if (!landmarks->problem && !landmarks->fingerprint && !landmarks->vertex && !landmarks->distance)
+        return false;
+
+    if (!landmarks->problem || !landmarks->fingerprint || !landmarks->vertex || !landmarks->distance ||
+        metrics == 0 || fingerprints != metrics || vertices % metrics || distances != vertices * graph.vertexCount())
+    {
+        error = "landmark sections are missing or inconsistent";
+        return false;
+    }
+
+    for (size_t m = 0; m < metrics; m++)
+        if (landmarks->problem[m] < 1 || landmarks->problem[m] > PROBLEMS)
+        {
+            error = "landmark table for an unknown problem";
+            return false;
+        }
+
+    landmarks->metrics = metrics;
+    landmarks->count = vertices / metrics;
+    landmarks->vertices = graph.vertexCount();
+    landmarks->storage = snapshot;
+    graph.landmarks = landmarks;
+    return true;
+}
+
+/*
+    ALT potential towards dst for one query. Only the ACTIVE landmarks that
+    bound src -> dst best are consulted. Query vertices are not in the
+    tables; their landmark costs are worked out from the vertices they were
+    attached to, which is exact since the overlay only cuts edges in two
+    and hangs walking edges off them.
+*/
+class LandmarkBound
+{
+public:
+    LandmarkBound(const Landmarks &landmarks, int metric, const ProblemSpec &problem, const QueryGraph &graph, int src, int dst)
+        : landmarks(landmarks), metric(metric), base(graph.graph.vertexCount())
+    {
+        int count = landmarks.count;
+
+        // extra vertices hang off vertices with smaller IDs, so one pass in ID order has them all
+        extra.assign((size_t)(graph.vertexCount() - base) * count, std::numeric_limits<double>::infinity());
+        for (int x = base; x < graph.vertexCount(); x++)
+            for (int e : graph.edges(x))
+            {
+                int mode = graph.mode(e);
+                int n = graph.target(e);
+                if (n >= x || !(problem.modes >> mode & 1))
+                    continue;
+
+                double weight = edgeWeight(problem, graph.length(e), mode);
+                for (int i = 0; i < count; i++)
+                {
+                    double &d = extra[(size_t)(x - base) * count + i];
+                    d = std::min(d, distance(n, i) + weight);
+                }
+            }
+
+        std::vector<std::pair<double, int>> ranked;
+        for (int i = 0; i < count; i++)
+        {
+            double s = distance(src, i), t = distance(dst, i);
+            if (std::isfinite(s) && std::isfinite(t))
+                ranked.push_back({-std::fabs(s - t), i});
+        }
+        std::sort(ranked.begin(), ranked.end());
+
+        active = std::min((int)ranked.size(), ACTIVE);
+        for (int k = 0; k < active; k++)
+        {
+            landmark[k] = ranked[k].second;
+            toDst[k] = distance(dst, landmark[k]);
+        }
+    }
+
+    double operator()(int v) const
+    {
+        double bound = 0;
+        for (int k = 0; k < active; k++)
+        {
+            double d = distance(v, landmark[k]);
+            if (!std::isfinite(d))
+                continue;
+
+            // costs are stored as floats, give back their rounding
+            double gap = std::fabs(toDst[k] - d) - 1e-6 * (toDst[k] + d);
+            bound = std::max(bound, gap);
+        }
+        return bound;
+    }
+
+private:
+    static constexpr int ACTIVE = 4;
+
+    const Landmarks &landmarks;
+    int metric;
+    int base; // first extra vertex
+    std::vector<double> extra;
+
+    int active = 0;
+    int landmark[ACTIVE];
+    double toDst[ACTIVE];
+
+    double distance(int v, int i) const
+    {
+        if (v < base)
+            return landmarks.distances(metric, v)[i];
+        return extra[(size_t)(v - base) * landmarks.count + i];
+    }
+};
+
+/*
+    ALT search from src to dst for Problems 1-3. Falls back to
+    bidirectionalDijkstra() when the graph has no table for the problem
+    (e.g. it was read from the CSV files). Returns the number of nodes
+    settled.
+*/
+template <class Queue = QuadHeap>
+inline int alt(const ProblemSpec &problem, int src, int dst, SearchContext &nodes, const QueryGraph &graph)
+{
+    const Landmarks *landmarks = graph.graph.landmarks.get();
+    int metric = landmarks ? landmarks->metricOf(problem.number) : -1;
+    if (metric == -1)
+        return bidirectionalDijkstra<Queue>(problem, src, dst, nodes, graph);
+
+    LandmarkBound bound(*landmarks, metric, problem, graph, src, dst);
+    return dijkstraTo<Queue>(problem, src, std::vector<int>(1, dst), nodes, graph, 0, std::numeric_limits<double>::infinity(), bound);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+    A whole file mapped read-only into memory. Readers scan it in place
+    instead of copying it through an istream, and the pages stay shared
+    with the OS page cache. Not copyable, the mapping is released when the
+    object goes away.
+*/
+class MappedFile
+{
+public:
+    MappedFile() {}
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    // error is "missing" when the file cannot be opened at all
+    bool open(const std::string &path, std::string &error)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            error = "missing";
+            return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            error = "cannot stat file";
+            return false;
+        }
+
+        length = info.st_size;
+        if (length == 0) // mmap refuses empty files, an empty file is simply no data
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void *base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+
+        if (base == MAP_FAILED)
+        {
+            length = 0;
+            error = "cannot map file";
+            return false;
+        }
+
+        bytes = (const char *)base;
+        return true;
+    }
+
+    void close()
+    {
+        if (bytes)
+            munmap((void *)bytes, length);
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const char *data() const
+    {
+        return bytes;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+};
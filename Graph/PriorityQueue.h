@@ -0,0 +1,314 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+/*
+    Addressable min-priority queues over the IDs 0 .. n-1, for Dijkstra.
+
+    Only IDs that were pushed are in the queue, and each ID remembers where
+    it is, so push() of a queued ID lowers its key in place instead of
+    searching for the old entry. Entries are ordered by (key, ID): equal
+    keys come out smallest ID first, so every queue here pops the same
+    sequence. An ID once popped stays done() until the next reset() or
+    until it is pushed again. A queue kept between searches resets in time
+    for the IDs the last search pushed, not all n, also when n changes with
+    the query overlay; its arrays only grow.
+
+    Both queues have the same interface and can be swapped as a template
+    argument:
+
+        IndexedHeap<4>  implicit d-ary heap in one array, the default
+        PairingHeap     fewer comparisons per decrease-key, more pointer chasing
+*/
+
+template <int D = 4>
+class IndexedHeap
+{
+public:
+    // empties the queue for IDs 0 .. n-1
+    void reset(int n)
+    {
+        heap.clear();
+        for (int id : seen)
+            position[id] = UNSEEN;
+        seen.clear();
+        if ((int)position.size() < n)
+            position.resize(n, UNSEEN);
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    int size() const
+    {
+        return heap.size();
+    }
+
+    bool queued(int id) const
+    {
+        return position[id] >= 0;
+    }
+
+    bool done(int id) const
+    {
+        return position[id] == DONE;
+    }
+
+    double key(int id) const
+    {
+        return heap[position[id]].first;
+    }
+
+    // inserts id, or lowers its key when it is queued already; a higher key is ignored
+    void push(int id, double key)
+    {
+        int at = position[id];
+        if (at < 0)
+        {
+            if (at == UNSEEN)
+                seen.push_back(id);
+            at = heap.size();
+            heap.push_back({key, id});
+        }
+        else if (key < heap[at].first)
+            heap[at].first = key;
+        else
+            return;
+
+        siftUp(at);
+    }
+
+    // entry with the smallest key, as (key, id)
+    std::pair<double, int> top() const
+    {
+        return heap[0];
+    }
+
+    // removes and returns the entry with the smallest key
+    std::pair<double, int> pop()
+    {
+        std::pair<double, int> top = heap[0];
+        position[top.second] = DONE;
+
+        std::pair<double, int> last = heap.back();
+        heap.pop_back();
+        if (!heap.empty())
+        {
+            heap[0] = last;
+            position[last.second] = 0;
+            siftDown(0);
+        }
+
+        return top;
+    }
+
+private:
+    static constexpr int UNSEEN = -1;
+    static constexpr int DONE = -2;
+
+    std::vector<std::pair<double, int>> heap; // (key, id), children of i at D*i+1 .. D*i+D
+    std::vector<int> position;                // index in heap, UNSEEN or DONE
+    std::vector<int> seen;                    // IDs pushed since reset()
+
+    void siftUp(int at)
+    {
+        std::pair<double, int> entry = heap[at];
+        while (at > 0)
+        {
+            int parent = (at - 1) / D;
+            if (!(entry < heap[parent]))
+                break;
+
+            heap[at] = heap[parent];
+            position[heap[at].second] = at;
+            at = parent;
+        }
+        heap[at] = entry;
+        position[entry.second] = at;
+    }
+
+    void siftDown(int at)
+    {
+        std::pair<double, int> entry = heap[at];
+        int n = heap.size();
+        while (true)
+        {
+            int first = D * at + 1;
+            if (first >= n)
+                break;
+
+            int smallest = first;
+            for (int c = first + 1; c < first + D && c < n; c++)
+                if (heap[c] < heap[smallest])
+                    smallest = c;
+
+            if (!(heap[smallest] < entry))
+                break;
+
+            heap[at] = heap[smallest];
+            position[heap[at].second] = at;
+            at = smallest;
+        }
+        heap[at] = entry;
+        position[entry.second] = at;
+    }
+};
+
+class PairingHeap
+{
+public:
+    void reset(int n)
+    {
+        root = NONE;
+        count = 0;
+        for (int id : seen)
+            nodes[id] = Item();
+        seen.clear();
+        if ((int)nodes.size() < n)
+            nodes.resize(n, Item());
+    }
+
+    bool empty() const
+    {
+        return root == NONE;
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    bool queued(int id) const
+    {
+        return nodes[id].state == QUEUED;
+    }
+
+    bool done(int id) const
+    {
+        return nodes[id].state == DONE;
+    }
+
+    double key(int id) const
+    {
+        return nodes[id].key;
+    }
+
+    void push(int id, double key)
+    {
+        Item &item = nodes[id];
+        if (item.state != QUEUED)
+        {
+            if (item.state == UNSEEN)
+                seen.push_back(id);
+            item = Item();
+            item.key = key;
+            item.state = QUEUED;
+            count++;
+            root = root == NONE ? id : meld(root, id);
+            return;
+        }
+
+        if (!(key < item.key))
+            return;
+
+        item.key = key;
+        if (id == root)
+            return;
+
+        // cut the subtree off its parent and meld it back in at the top
+        if (nodes[item.prev].child == id)
+            nodes[item.prev].child = item.next;
+        else
+            nodes[item.prev].next = item.next;
+        if (item.next != NONE)
+            nodes[item.next].prev = item.prev;
+
+        item.prev = item.next = NONE;
+        root = meld(root, id);
+    }
+
+    std::pair<double, int> top() const
+    {
+        return {nodes[root].key, root};
+    }
+
+    std::pair<double, int> pop()
+    {
+        int top = root;
+        nodes[top].state = DONE;
+        count--;
+
+        // two-pass pairing of the children: meld them in pairs left to right, then fold right to left
+        pairs.clear();
+        for (int c = nodes[top].child; c != NONE;)
+        {
+            int a = c, b = nodes[a].next;
+            c = b == NONE ? NONE : nodes[b].next;
+
+            nodes[a].prev = nodes[a].next = NONE;
+            if (b != NONE)
+            {
+                nodes[b].prev = nodes[b].next = NONE;
+                a = meld(a, b);
+            }
+            pairs.push_back(a);
+        }
+
+        root = NONE;
+        for (int i = (int)pairs.size() - 1; i >= 0; i--)
+            root = root == NONE ? pairs[i] : meld(pairs[i], root);
+
+        return {nodes[top].key, top};
+    }
+
+private:
+    static constexpr int NONE = -1;
+    enum State
+    {
+        UNSEEN,
+        QUEUED,
+        DONE
+    };
+
+    struct Item
+    {
+        double key = 0;
+        int child = NONE; // leftmost child
+        int next = NONE;  // right sibling
+        int prev = NONE;  // left sibling, the parent for a leftmost child
+        State state = UNSEEN;
+    };
+
+    std::vector<Item> nodes; // by ID
+    std::vector<int> pairs;  // scratch for pop()
+    std::vector<int> seen;   // IDs pushed since reset()
+    int root = NONE;
+    int count = 0;
+
+    bool less(int a, int b) const
+    {
+        return nodes[a].key < nodes[b].key || (nodes[a].key == nodes[b].key && a < b);
+    }
+
+    // links two roots, the larger becomes the leftmost child of the smaller
+    int meld(int a, int b)
+    {
+        if (less(b, a))
+            std::swap(a, b);
+
+        Item &parent = nodes[a];
+        Item &child = nodes[b];
+        child.prev = a;
+        child.next = parent.child;
+        if (parent.child != NONE)
+            nodes[parent.child].prev = b;
+        parent.child = b;
+
+        return a;
+    }
+};
+
+typedef IndexedHeap<4> QuadHeap;
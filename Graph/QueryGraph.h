@@ -0,0 +1,291 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "Geo.h"
+
+/*
+    The shared graph plus the handful of vertices and edges a single query
+    glues onto it (the snapped source / destination, the points where they
+    meet the road and the edges joining them in). The shared graph itself
+    is never touched, so any number of queries can share it.
+
+    Extra vertices get IDs after the graph's own and extra edges get slots
+    after the graph's own, so search labels and prevEdge treat both alike:
+
+        for (int e : query.edges(v))
+            relax(query.target(e), query.length(e), query.mode(e));
+
+    visits the CSR slots of v first and then the extra edges leaving v, the
+    same order as if the extra edges had been appended to the graph.
+*/
+struct QueryGraph
+{
+    const CSRGraph &graph;
+    std::vector<std::pair<double, double>> extraLonLat;
+    std::vector<GraphEdge> extraEdges;
+
+    // extra edges leaving each vertex, as lists through extraEdges in the order they were added
+    std::vector<int> firstExtra;   // -1 for a vertex without extra edges
+    std::vector<int> lastExtra;
+    std::vector<int> nextExtra;    // -1 after the last edge of its vertex
+    std::vector<int> extraSources; // vertices whose lists clear() empties
+
+    // split vertex `vertex` sits a fraction t along graph segment from-to
+    struct Split
+    {
+        int from;
+        int to;
+        double t;
+        int vertex;
+    };
+    std::vector<Split> splits;
+
+    QueryGraph(const CSRGraph &graph) : graph(graph) {}
+
+    int addVertex(std::pair<double, double> lon_lat)
+    {
+        extraLonLat.push_back(lon_lat);
+        return graph.vertexCount() + extraLonLat.size() - 1;
+    }
+
+    void addEdge(int from, int to, double length, int mode)
+    {
+        if ((int)firstExtra.size() < vertexCount())
+        {
+            firstExtra.resize(vertexCount(), -1);
+            lastExtra.resize(vertexCount(), -1);
+        }
+
+        int k = extraEdges.size();
+        extraEdges.push_back({from, to, length, mode});
+        nextExtra.push_back(-1);
+
+        if (firstExtra[from] == -1)
+        {
+            firstExtra[from] = k;
+            extraSources.push_back(from);
+        }
+        else
+            nextExtra[lastExtra[from]] = k;
+        lastExtra[from] = k;
+    }
+
+    // drops the previous query's vertices and edges, so one overlay can serve a stream of queries
+    void clear()
+    {
+        for (int v : extraSources)
+            firstExtra[v] = lastExtra[v] = -1;
+        extraSources.clear();
+
+        extraLonLat.clear();
+        extraEdges.clear();
+        nextExtra.clear();
+        splits.clear();
+    }
+
+    /*
+        Vertex for a query coordinate: the graph vertex at exactly that spot,
+        otherwise a new vertex joined by walking edges to the nearest graph
+        vertex other than `avoid` and, when it is closer, to the nearest
+        road segment, split there by a temporary vertex. The search picks
+        whichever start is better for the problem, so the split never costs
+        more than walking to the vertex did. Only vertices with an edge of
+        one of `modes` are candidates, so a road-only problem never lands
+        on a metro-only vertex.
+    */
+    int attach(std::pair<double, double> lon_lat, unsigned modes, int avoid = -1)
+    {
+        for (int i = 0; i < (int)extraLonLat.size(); i++)
+            if (extraLonLat[i] == lon_lat)
+                return graph.vertexCount() + i;
+
+        double nearestNodeDist;
+        int nearestNode = graph.nearestVertex(lon_lat, modes, avoid, nearestNodeDist);
+
+        if (nearestNode == -1 || nearestNodeDist == 0)
+            return nearestNode;
+
+        int id = addVertex(lon_lat);
+        addEdge(id, nearestNode, nearestNodeDist, 1);
+        addEdge(nearestNode, id, nearestNodeDist, 1);
+
+        SegmentMatch match;
+        if (graph.nearestSegment(lon_lat, modes & ROAD_MODES, match) && match.distance < nearestNodeDist)
+        {
+            int split = splitSegment(match);
+            if (split != avoid && split != nearestNode)
+            {
+                addEdge(id, split, match.distance, 1);
+                addEdge(split, id, match.distance, 1);
+            }
+        }
+
+        return id;
+    }
+
+    int vertexCount() const
+    {
+        return graph.vertexCount() + extraLonLat.size();
+    }
+
+    int edgeCount() const
+    {
+        return graph.edgeCount() + extraEdges.size();
+    }
+
+    std::pair<double, double> lonLat(int v) const
+    {
+        if (v < graph.vertexCount())
+            return graph.lonLat(v);
+        return extraLonLat[v - graph.vertexCount()];
+    }
+
+    int target(int e) const
+    {
+        if (e < graph.edgeCount())
+            return graph.target[e];
+        return extraEdges[e - graph.edgeCount()].to;
+    }
+
+    double length(int e) const
+    {
+        if (e < graph.edgeCount())
+            return graph.length[e];
+        return extraEdges[e - graph.edgeCount()].length;
+    }
+
+    int mode(int e) const
+    {
+        if (e < graph.edgeCount())
+            return graph.mode[e];
+        return extraEdges[e - graph.edgeCount()].mode;
+    }
+
+    class EdgeIterator
+    {
+    public:
+        EdgeIterator(const QueryGraph &query, int v, int e) : query(query), v(v), e(e) {}
+
+        int operator*() const
+        {
+            return e;
+        }
+
+        bool operator!=(const EdgeIterator &other) const
+        {
+            return e != other.e;
+        }
+
+        EdgeIterator &operator++()
+        {
+            if (e < query.graph.edgeCount() && e + 1 < query.graph.offset[v + 1])
+                e++;
+            else if (e < query.graph.edgeCount())
+                e = query.firstExtraEdge(v);
+            else
+                e = query.nextExtraEdge(e);
+            return *this;
+        }
+
+    private:
+        const QueryGraph &query;
+        int v;
+        int e;
+    };
+
+    struct EdgeRange
+    {
+        EdgeIterator first;
+        EdgeIterator last;
+
+        EdgeIterator begin() const
+        {
+            return first;
+        }
+
+        EdgeIterator end() const
+        {
+            return last;
+        }
+    };
+
+    EdgeRange edges(int v) const
+    {
+        int first;
+        if (v < graph.vertexCount() && graph.offset[v] < graph.offset[v + 1])
+            first = graph.offset[v];
+        else
+            first = firstExtraEdge(v);
+
+        return {EdgeIterator(*this, v, first), EdgeIterator(*this, v, edgeCount())};
+    }
+
+private:
+    /*
+        Vertex at the matched point: an end of the segment, or a new vertex
+        cutting it in two. Every road edge between the segment's ends gets
+        both halves, in both directions; metro and bus edges along the same
+        segment are left whole, vehicles only stop at their stations. A
+        second split on the same segment joins the split points next to it.
+    */
+    int splitSegment(const SegmentMatch &match)
+    {
+        int u = match.segment.from, v = match.segment.to;
+        double t = match.t;
+
+        if (t <= 0)
+            return u;
+        if (t >= 1)
+            return v;
+
+        int lower = u, upper = v;
+        double lowerT = 0, upperT = 1;
+        for (const Split &split : splits)
+        {
+            if (split.from != u || split.to != v)
+                continue;
+            if (split.t == t)
+                return split.vertex;
+            if (split.t < t && split.t > lowerT)
+                lower = split.vertex, lowerT = split.t;
+            if (split.t > t && split.t < upperT)
+                upper = split.vertex, upperT = split.t;
+        }
+
+        int id = addVertex(match.point);
+        splits.push_back({u, v, t, id});
+
+        for (int e = graph.offset[u]; e < graph.offset[u + 1]; e++)
+        {
+            int mode = graph.mode[e];
+            if (graph.target[e] != v || !(ROAD_MODES >> mode & 1))
+                continue;
+
+            double length = graph.length[e];
+
+            addEdge(lower, id, length * (t - lowerT), mode);
+            addEdge(id, lower, length * (t - lowerT), mode);
+            addEdge(id, upper, length * (upperT - t), mode);
+            addEdge(upper, id, length * (upperT - t), mode);
+        }
+
+        return id;
+    }
+
+    // slot of the first extra edge leaving v, edgeCount() when there is none
+    int firstExtraEdge(int v) const
+    {
+        int k = v < (int)firstExtra.size() ? firstExtra[v] : -1;
+        return k == -1 ? edgeCount() : graph.edgeCount() + k;
+    }
+
+    // slot of the extra edge after e leaving the same vertex, edgeCount() after the last
+    int nextExtraEdge(int e) const
+    {
+        int k = nextExtra[e - graph.edgeCount()];
+        return k == -1 ? edgeCount() : graph.edgeCount() + k;
+    }
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "AStar.h"
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+#include "Routing.h"
+#include "Timetable.h"
+
+/*
+    RAPTOR: the earliest arrival for every number of metro and bus vehicles
+    taken, over the lines of a Timetable, in one query.
+
+    Round k rides one more vehicle than round k-1. It scans every line
+    through a stop that round k-1 improved, from the first such stop on:
+    the earliest trip catchable there with the arrival of round k-1 is
+    ridden down the line, a later stop moving to an earlier trip when round
+    k-1 got there in time for one. Then a road search from the stops the
+    rides improved walks and drives on to other stops and the destination,
+    the footpaths between rounds (stops lie on the road graph, so there is
+    no footpath table). Round 0 is that road search from the source alone.
+
+    A label is only kept when it beats the best arrival of any round at
+    its vertex, and nothing that cannot beat the best arrival at the
+    destination is explored, the same straight-line time bound (GoalBound)
+    as connectionScan(). So the rounds stay small, and every round that
+    improves the destination gives a journey that needs more vehicles but
+    arrives earlier than the one before. No preprocessing beyond the
+    timetable.
+*/
+
+// A journey found by Raptor::run()
+struct TransitOption
+{
+    int vehicles;   // metro and bus trips taken
+    double arrival; // at the destination, minutes after midnight
+};
+
+// Rounds a query runs at most beyond the road search, i.e. vehicles a journey may take
+const int MAX_VEHICLES = 5;
+
+/*
+    Labels are kept per round so any option's journey can be written out
+    afterwards. Not thread-safe, one per thread, reusable across queries on
+    the same timetable.
+*/
+template <class Queue = QuadHeap>
+class Raptor
+{
+public:
+    explicit Raptor(const Timetable &timetable) : timetable(timetable) {}
+
+    /*
+        Options to dst leaving src at `startingTime`, no later than
+        `scheduledTime`, taking at most `maxVehicles` vehicles: fewest
+        vehicles first, each arriving earlier than the one before. Returns
+        the nodes the road searches settled plus the stops the rides
+        improved.
+    */
+    int run(const ProblemSpec &problem, int src, int dst, const QueryGraph &graph, double startingTime,
+            double scheduledTime = std::numeric_limits<double>::infinity(), int maxVehicles = MAX_VEHICLES)
+    {
+        int n = graph.vertexCount();
+        this->problem = &problem;
+        this->graph = &graph;
+        this->src = src;
+        this->dst = dst;
+        options.clear();
+
+        if ((int)rounds.size() < maxVehicles + 1)
+        {
+            rounds.resize(maxVehicles + 1);
+            rides.resize(maxVehicles + 1);
+        }
+        best.reset(n);
+        if (marked.size() < timetable.stopVertex.size())
+        {
+            marked.resize(timetable.stopVertex.size(), 0);
+            lineFrom.resize(timetable.lines.size(), -1);
+        }
+
+        roadModes = 0;
+        for (int mode = 1; mode <= 5; mode++)
+            if ((problem.modes >> mode & 1) && !problem.runsEvery[mode])
+                roadModes |= 1u << mode;
+
+        ProblemSpec fastest = problem;
+        fastest.objective = MIN_ARRIVAL;
+        GoalBound potential(fastest, graph, dst);
+
+        rounds[0].reset(n);
+        rounds[0][src] = {startingTime, -1, -1, startingTime, 0};
+        best[src].arrivalTime = startingTime;
+
+        int settled = 0;
+        std::vector<int> seeds(1, src);
+        for (int k = 0;; k++)
+        {
+            settled += roadSearch(k, seeds, potential, scheduledTime);
+            if (rounds[k][dst].arrivalTime != INT_MAX)
+                options.push_back({k, rounds[k][dst].arrivalTime});
+
+            if (k == maxVehicles || stops.empty())
+                break;
+
+            rounds[k + 1].reset(n);
+            settled += scanLines(k + 1, seeds, scheduledTime);
+        }
+
+        for (int s : stops)
+            marked[s] = 0;
+        stops.clear();
+        return settled;
+    }
+
+    // from the last run(), fewest vehicles first
+    const std::vector<TransitOption> &lastOptions() const
+    {
+        return options;
+    }
+
+    /*
+        Writes the journey of `option` to `nodes` like connectionScan()
+        does: prev, prevEdge, arrival times and waits along the vehicles
+        ridden, and cost as the problem counts it.
+    */
+    void writeJourney(const TransitOption &option, SearchContext &nodes) const
+    {
+        std::vector<std::pair<int, Node>> trip;
+        int k = option.vehicles;
+        for (int v = dst; v != src;)
+        {
+            while (rounds[k][v].arrivalTime == INT_MAX) // not improved since an earlier round
+                k--;
+
+            const Node &label = rounds[k][v];
+            if (!problem->runsEvery[graph->mode(label.prevEdge)])
+            {
+                trip.push_back({v, label});
+                v = label.prev;
+                continue;
+            }
+
+            const Ride &ride = rides[k][timetable.stop(v)];
+            const TransitLine &line = timetable.lines[timetable.tripLine[ride.trip]];
+            for (int i = ride.exit - 1; i >= ride.board; i--)
+            {
+                double arrival = timetable.departure(ride.trip, i + 1);
+                double waiting = i == ride.board ? timetable.departure(ride.trip, i) - arrivalBy(line.stops[i], k - 1) : 0;
+                trip.push_back({line.stops[i + 1], Node{arrival, line.stops[i], line.edges[i], arrival, waiting}});
+            }
+            v = line.stops[ride.board];
+            k--;
+        }
+        trip.push_back({src, rounds[0][src]});
+        std::reverse(trip.begin(), trip.end());
+
+        nodes.reset(graph->vertexCount());
+        writeTrip(trip, nodes);
+        writePathCosts(*problem, dst, nodes, *graph);
+    }
+
+private:
+    // the trip that reached a stop in a round, and the indices it was boarded and left at
+    struct Ride
+    {
+        int trip;
+        int board;
+        int exit;
+    };
+
+    const Timetable &timetable;
+    const ProblemSpec *problem = nullptr;
+    const QueryGraph *graph = nullptr;
+    int src = -1, dst = -1;
+    unsigned roadModes = 0;
+
+    std::vector<SearchContext> rounds;     // labels each round improved
+    std::vector<std::vector<Ride>> rides;  // of each stop whose round label is a ride
+    SearchContext best;                    // best arrival of any round, for pruning
+    std::vector<int> stops;                // improved in the last round
+    std::vector<char> marked;              // of each stop, whether it is in `stops`
+    std::vector<int> lineFrom, lines;      // first marked index of each line to scan
+    std::vector<TransitOption> options;
+    Queue queue;
+
+    // arrival at v with at most k vehicles
+    double arrivalBy(int v, int k) const
+    {
+        for (; k >= 0; k--)
+            if (rounds[k][v].arrivalTime != INT_MAX)
+                return rounds[k][v].arrivalTime;
+        return INT_MAX;
+    }
+
+    // labels v in round k if that beats every round so far
+    bool improve(int k, int v, const Node &label)
+    {
+        if (label.arrivalTime >= best[v].arrivalTime || label.arrivalTime >= best[dst].arrivalTime)
+            return false;
+
+        best[v].arrivalTime = label.arrivalTime;
+        rounds[k][v] = label;
+
+        int s = timetable.stop(v);
+        if (s != -1 && !marked[s])
+        {
+            marked[s] = 1;
+            stops.push_back(s);
+        }
+        return true;
+    }
+
+    // round k's walking and driving on from `seeds`, which it empties
+    int roadSearch(int k, std::vector<int> &seeds, const GoalBound &potential, double scheduledTime)
+    {
+        const ProblemSpec &problem = *this->problem;
+        const QueryGraph &graph = *this->graph;
+
+        queue.reset(graph.vertexCount());
+        for (int v : seeds)
+            queue.push(v, rounds[k][v].arrivalTime + potential(v));
+        seeds.clear();
+
+        int settled = 0;
+        while (!queue.empty())
+        {
+            std::pair<double, int> top = queue.pop();
+            if (top.first >= best[dst].arrivalTime)
+                break;
+
+            int v = top.second;
+            double arrival_v = rounds[k][v].arrivalTime;
+            settled++;
+
+            for (int e : graph.edges(v))
+            {
+                int mode = graph.mode(e);
+                if (!(roadModes >> mode & 1))
+                    continue;
+
+                int u = graph.target(e);
+                double arrivalTime = arrival_v + graph.length(e) / problem.speed[mode] * 60.0;
+                if (arrivalTime <= scheduledTime && improve(k, u, {arrivalTime, v, e, arrivalTime, 0}))
+                    queue.push(u, arrivalTime + potential(u));
+            }
+        }
+        return settled;
+    }
+
+    // round k's rides on every line through a stop round k-1 improved, leaving the stops they improve in `seeds`
+    int scanLines(int k, std::vector<int> &seeds, double scheduledTime)
+    {
+        for (int s : stops)
+        {
+            marked[s] = 0;
+            for (const std::pair<int, int> &at : timetable.serving[s])
+            {
+                int &from = lineFrom[at.first];
+                if (from == -1)
+                    lines.push_back(at.first);
+                if (from == -1 || at.second < from)
+                    from = at.second;
+            }
+        }
+        stops.clear();
+
+        if (rides[k].size() < timetable.stopVertex.size())
+            rides[k].resize(timetable.stopVertex.size());
+
+        int improved = 0;
+        for (int l : lines)
+        {
+            const TransitLine &line = timetable.lines[l];
+            int trip = -1, board = -1;
+            for (int i = lineFrom[l]; i < (int)line.stops.size(); i++)
+            {
+                int v = line.stops[i];
+                if (trip != -1)
+                {
+                    double arrival = timetable.departure(trip, i);
+                    if (arrival <= scheduledTime && improve(k, v, {arrival, line.stops[board], line.edges[i - 1], arrival, 0}))
+                    {
+                        rides[k][timetable.stop(v)] = {trip, board, i};
+                        seeds.push_back(v);
+                        improved++;
+                    }
+                }
+
+                // an earlier trip when the last round got here before this one leaves
+                double reached = arrivalBy(v, k - 1);
+                if (reached == INT_MAX || (trip != -1 && reached > timetable.departure(trip, i)))
+                    continue;
+                int earlier = timetable.earliestTrip(l, i, reached);
+                if (earlier != -1 && (trip == -1 || earlier < trip))
+                {
+                    trip = earlier;
+                    board = i;
+                }
+            }
+            lineFrom[l] = -1;
+        }
+        lines.clear();
+        return improved;
+    }
+};
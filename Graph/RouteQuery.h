@@ -0,0 +1,343 @@
+#pragma once
+
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AStar.h"
+#include "Bidirectional.h"
+#include "Clock.h"
+#include "ContractionHierarchy.h"
+#include "Customizable.h"
+#include "HubLabels.h"
+#include "Landmarks.h"
+#include "CSRGraph.h"
+#include "ConnectionScan.h"
+#include "QueryGraph.h"
+#include "Raptor.h"
+#include "Routing.h"
+#include "Timetable.h"
+
+/*
+    One route request as a line of text, the format read by the batch and
+    server front ends:
+
+        [distance|timetable|changes] problem srcLon srcLat dstLon dstLat [startingTime] [scheduledTime]
+
+    e.g. "4 90.363824 23.834127 90.375864 23.723166 05:43pm". Problems 4-6
+    need a starting time, Problem 6 also the scheduled (deadline) time. A
+    leading "distance" only asks for the distance, which the hub labels
+    answer in microseconds without building the route (Problem 1). A
+    leading "timetable" asks Problem 5 for the earliest arrival on the
+    lines and trips of Timetable.h, found by connectionScan(); the fare
+    problems are refused, the timetable engines do not minimise cost. A
+    leading "changes" asks the same timetable for every journey that takes
+    more vehicles to arrive earlier, up to MAX_VEHICLES, found by Raptor.
+*/
+struct RouteQuery
+{
+    bool distanceOnly = false;
+    bool timetable = false;
+    bool changes = false; // timetable too
+    int problem = 0;
+    std::pair<double, double> src_lonLat;
+    std::pair<double, double> dst_lonLat;
+    double startingTime = 0;
+    double scheduledTime = std::numeric_limits<double>::infinity();
+};
+
+inline bool parseRouteQuery(const std::string &line, RouteQuery &query, std::string &error)
+{
+    std::istringstream in(line);
+    query = RouteQuery();
+
+    std::string first;
+    in >> first;
+    if (first == "distance")
+        query.distanceOnly = true;
+    else if (first == "timetable")
+        query.timetable = true;
+    else if (first == "changes")
+        query.timetable = query.changes = true;
+    else
+        in.seekg(0);
+
+    if (!(in >> query.problem) || query.problem < 1 || query.problem > PROBLEMS)
+    {
+        error = "problem must be 1 to " + std::to_string(PROBLEMS);
+        return false;
+    }
+
+    if (!(in >> query.src_lonLat.first >> query.src_lonLat.second >> query.dst_lonLat.first >> query.dst_lonLat.second))
+    {
+        error = "expected source and destination longitude latitude";
+        return false;
+    }
+
+    const ProblemSpec &problem = problemSpec(query.problem);
+    std::string startingTime_str, scheduledTime_str;
+
+    if (query.timetable && problem.objective != MIN_ARRIVAL)
+    {
+        error = first + " only answers Problem 5 (earliest arrival)";
+        return false;
+    }
+
+    if (problem.timed)
+    {
+        if (!(in >> startingTime_str) || !isTimeOfDay(startingTime_str))
+        {
+            error = "expected a starting time like 05:43pm";
+            return false;
+        }
+        query.startingTime = convertTimeToMinutes(startingTime_str);
+    }
+
+    if (query.problem == 6)
+    {
+        if (!(in >> scheduledTime_str) || !isTimeOfDay(scheduledTime_str))
+        {
+            error = "expected a scheduled time like 08:40pm";
+            return false;
+        }
+        query.scheduledTime = convertTimeToMinutes(scheduledTime_str);
+    }
+
+    std::string rest;
+    if (in >> rest)
+    {
+        error = "unexpected " + rest;
+        return false;
+    }
+
+    return true;
+}
+
+struct RouteResult
+{
+    bool found = false;
+    double distance = 0; // km along the path
+    double cost = 0;     // Tk, problems minimising cost
+    double departure = 0;
+    double arrival = 0; // minutes after midnight, timed problems
+    std::string legs;   // modes used in order, e.g. "Walk>Metro>Walk", a new leg for every vehicle boarded
+    int vehicles = 0;   // metro and bus trips taken, timetable queries
+    int settled = 0;    // nodes the search settled, labels merged for a hub label route
+};
+
+/*
+    Answers route queries one after another against a loaded graph. The
+    query overlay and search labels are kept between queries, so after the
+    first query nothing is allocated per query beyond the search itself.
+    Not thread-safe, give every thread its own solver.
+*/
+class RouteSolver
+{
+public:
+    explicit RouteSolver(const CSRGraph &graph) : query(graph) {}
+
+    // `metrics` overrides the costs of the problems it has, e.g. fares changed at runtime; a changes query gives its earliest option
+    RouteResult solve(const RouteQuery &request, const MetricSet *metrics = nullptr)
+    {
+        if (request.changes)
+        {
+            std::vector<RouteResult> options = solveOptions(request, metrics);
+            return options.empty() ? RouteResult() : options.back();
+        }
+
+        const MetricSet::Metric *custom = metrics ? metrics->find(request.problem) : nullptr;
+        const ProblemSpec &problem = custom ? custom->problem : problemSpec(request.problem);
+        RouteResult result;
+
+        query.clear();
+        int srcID = query.attach(request.src_lonLat, problem.modes);
+        int dstID = query.attach(request.dst_lonLat, problem.modes, srcID);
+        if (srcID == -1 || dstID == -1)
+            return result;
+
+        // no route wanted: the hub labels have the distance unless the costs were changed, legs stay empty
+        bool defaultCosts = !custom || metricFingerprint(problem) == metricFingerprint(problemSpec(request.problem));
+        if (request.distanceOnly && defaultCosts && problem.objective == MIN_DISTANCE)
+        {
+            double distance = hubDistance(problem, srcID, dstID, query);
+            if (distance != -1)
+            {
+                result.found = distance != INT_MAX;
+                if (result.found)
+                    result.distance = distance;
+                return result;
+            }
+        }
+
+        // hub labels, else hierarchies for the fixed costs (customized ones first), else goal direction where the problem's tables give a bound
+        if (request.timetable)
+            result.settled = connectionScan(problem, timetable(request.problem), srcID, dstID, nodes, query, request.startingTime,
+                                            request.scheduledTime);
+        else if (custom)
+            result.settled = hierarchySearch(problem, *custom->hierarchy, 0, srcID, dstID, nodes, query);
+        else if (!problem.timed)
+            result.settled = hubSearch(problem, srcID, dstID, nodes, query);
+        else if (costPerKMBound(problem) > 0)
+            result.settled = astar(problem, srcID, dstID, nodes, query, request.startingTime, request.scheduledTime);
+        else
+            result.settled = dijkstraTo(problem, srcID, dstID, nodes, query, request.startingTime, request.scheduledTime);
+
+        describePath(problem, request, dstID, result);
+        return result;
+    }
+
+    /*
+        A changes query: one result per Raptor option, fewest vehicles
+        first, each arriving earlier than the one before; empty when there
+        is no path. lastPath() is the earliest option's.
+    */
+    std::vector<RouteResult> solveOptions(const RouteQuery &request, const MetricSet *metrics = nullptr)
+    {
+        const MetricSet::Metric *custom = metrics ? metrics->find(request.problem) : nullptr;
+        const ProblemSpec &problem = custom ? custom->problem : problemSpec(request.problem);
+        std::vector<RouteResult> results;
+
+        query.clear();
+        int srcID = query.attach(request.src_lonLat, problem.modes);
+        int dstID = query.attach(request.dst_lonLat, problem.modes, srcID);
+        if (srcID == -1 || dstID == -1)
+            return results;
+
+        std::unique_ptr<Raptor<>> &raptor = raptors[request.problem];
+        if (!raptor)
+            raptor.reset(new Raptor<>(timetable(request.problem)));
+        int settled = raptor->run(problem, srcID, dstID, query, request.startingTime, request.scheduledTime);
+
+        for (const TransitOption &option : raptor->lastOptions())
+        {
+            raptor->writeJourney(option, nodes);
+            results.emplace_back();
+            results.back().settled = settled;
+            describePath(problem, request, dstID, results.back());
+        }
+        return results;
+    }
+
+    // vertices of the last path found, valid until the next solve()
+    const std::vector<int> &lastPath() const
+    {
+        return path;
+    }
+
+    const QueryGraph &queryGraph() const
+    {
+        return query;
+    }
+
+private:
+    QueryGraph query;
+    SearchContext nodes;
+    std::vector<int> path;
+    std::shared_ptr<const Timetable> timetables[PROBLEMS + 1];
+    std::unique_ptr<Raptor<>> raptors[PROBLEMS + 1];
+
+    // built on the first timetable query of the problem
+    const Timetable &timetable(int number)
+    {
+        if (!timetables[number])
+            timetables[number] = std::make_shared<const Timetable>(buildTimetable(problemSpec(number), query.graph));
+        return *timetables[number];
+    }
+
+    // distance, times, cost and legs of the path to dstID in `nodes`, leaves `result` not found when there is none
+    void describePath(const ProblemSpec &problem, const RouteQuery &request, int dstID, RouteResult &result)
+    {
+        path = extractPath(nodes, dstID);
+        if (path.empty())
+            return;
+
+        result.found = true;
+        if (problem.objective == MIN_COST)
+            result.cost = nodes[dstID].cost;
+        if (problem.timed)
+        {
+            result.departure = request.startingTime;
+            result.arrival = nodes[dstID].arrivalTime;
+        }
+
+        int prevMode = 0;
+        for (int i = 1; i < (int)path.size(); i++)
+        {
+            int e = nodes[path[i]].prevEdge;
+            result.distance += query.length(e);
+
+            // waiting on a vehicle means boarding one, also on the mode just ridden
+            int mode = query.mode(e);
+            bool boarded = problem.runsEvery[mode] && (mode != prevMode || nodes[path[i]].waiting > 0);
+            if (mode != prevMode || boarded)
+            {
+                if (!result.legs.empty())
+                    result.legs += '>';
+                result.legs += modeName(mode);
+            }
+            result.vehicles += boarded;
+            prevMode = mode;
+        }
+    }
+};
+
+// Quotes a CSV field when it needs it
+inline std::string csvField(const std::string &text)
+{
+    if (text.find_first_of(",\"\r\n") == std::string::npos)
+        return text;
+
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"')
+            quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+const char *const RESULT_CSV_HEADER = "id,problem,status,distance_km,cost_tk,departure,arrival,travel_minutes,legs";
+
+/*
+    One CSV record for a query: status is "ok", "no path" or, when the line
+    could not be parsed, the parse error. Columns that do not apply to the
+    problem are left empty.
+*/
+inline std::string formatResultCSV(const std::string &id, const RouteQuery &request, const RouteResult &result, const std::string &error = "")
+{
+    std::string record = csvField(id) + ",";
+    if (!error.empty())
+        return record + "," + csvField(error) + ",,,,,,";
+
+    const ProblemSpec &problem = problemSpec(request.problem);
+    record += std::to_string(request.problem) + ",";
+
+    if (!result.found)
+        return record + "no path,,,,,,";
+
+    char number[64];
+    snprintf(number, sizeof(number), "%.6f", result.distance);
+    record += std::string("ok,") + number + ",";
+
+    if (problem.objective == MIN_COST)
+    {
+        snprintf(number, sizeof(number), "%.6f", result.cost);
+        record += number;
+    }
+    record += ",";
+
+    if (problem.timed)
+    {
+        snprintf(number, sizeof(number), "%.2f", result.arrival - result.departure);
+        record += convertMinutesToTime(result.departure) + "," + convertMinutesToTime(result.arrival) + "," + number;
+    }
+    else
+        record += ",,";
+
+    return record + "," + result.legs;
+}
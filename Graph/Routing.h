@@ -0,0 +1,835 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "PriorityQueue.h"
+#include "QueryGraph.h"
+
+/*
+    The six route problems as data. Every problem is the same Dijkstra over
+    the multimodal graph, they differ only in which modes may be used, what
+    is minimised and how fares and timetables work:
+
+        1  shortest distance, road only
+        2  cheapest fare, road and metro
+        3  cheapest fare, all modes
+        4  cheapest fare with time, vehicles every 15 minutes from 6am to 11pm
+        5  earliest arrival, same timetable as 4
+        6  cheapest fare arriving before a deadline, own speeds and headways
+
+    Per-mode tables are indexed by mode (1->Walk, 2->Car, 3->Metro,
+    4->Uttara Bus, 5->Bikolpo Bus), index 0 is unused.
+*/
+
+enum Objective
+{
+    MIN_DISTANCE, // km
+    MIN_COST,     // Tk
+    MIN_ARRIVAL,  // minutes after midnight
+};
+
+struct ProblemSpec
+{
+    int number;
+    const char *title; // KML document name
+    unsigned modes;
+    Objective objective;
+    bool timed;          // keeps arrival times and follows the timetable
+    double costPerKM[6]; // Tk
+    double speed[6];     // km per hour
+    int runsEvery[6];    // minutes between vehicles, 0 for modes without a timetable
+};
+
+const int PROBLEMS = 6;
+
+inline const ProblemSpec &problemSpec(int number)
+{
+    static const ProblemSpec problems[PROBLEMS + 1] = {
+        {},
+        {1, "Shortest Path", (1 << 1) | (1 << 2), MIN_DISTANCE, false, {}, {}, {}},
+        {2, "Cheapest Path", (1 << 1) | (1 << 2) | (1 << 3), MIN_COST, false, {0, 0, 20, 5}, {}, {}},
+        {3, "Cheapest Path", ALL_MODES, MIN_COST, false, {0, 0, 20, 5, 7, 7}, {}, {}},
+        {4, "Cheapest Path with time", ALL_MODES, MIN_COST, true, {0, 0, 20, 5, 7, 7}, {0, 2, 30, 30, 30, 30}, {0, 0, 0, 15, 15, 15}},
+        {5, "Fastest Path", ALL_MODES, MIN_ARRIVAL, true, {}, {0, 2, 10, 10, 10, 10}, {0, 0, 0, 15, 15, 15}},
+        {6, "Cheapest Path with scheduled time", ALL_MODES, MIN_COST, true, {0, 0, 20, 5, 10, 7}, {0, 2, 20, 15, 12, 10}, {0, 0, 0, 5, 10, 20}},
+    };
+    return problems[number];
+}
+
+inline const char *modeName(int mode)
+{
+    static const char *names[6] = {"", "Walk", "Car", "Metro", "UttaraBus", "BikolpoBus"};
+    return mode >= 1 && mode <= 5 ? names[mode] : "";
+}
+
+// Metro and buses only start a ride between 6am and 11pm
+const double SERVICE_START = 360;
+const double SERVICE_END = 1380;
+
+struct Node
+{
+    double cost; // what the problem minimises, see Objective
+    int prev;
+    int prevEdge;       // edge slot used to reach this node
+    double arrivalTime; // minutes after midnight, timed problems only
+    double waiting;     // minutes spent waiting for the vehicle of prevEdge
+};
+
+// Minutes from `arrivalTime` until the next vehicle that runs every `runsEvery` minutes
+inline double waitingTime(double arrivalTime, int runsEvery)
+{
+    int at_INT = arrivalTime;
+    if ((at_INT % runsEvery) || (arrivalTime - at_INT > 0.0))
+    {
+        double wait_until = at_INT - (at_INT % runsEvery) + runsEvery;
+        return wait_until - arrivalTime;
+    }
+    return 0;
+}
+
+// Cost of one edge for the problems without a timetable: km, or Tk
+inline double edgeWeight(const ProblemSpec &problem, double length, int mode)
+{
+    if (problem.objective == MIN_DISTANCE)
+        return length;
+    return length * problem.costPerKM[mode];
+}
+
+/*
+    The labels of one search, kept apart from the graph so any number of
+    searches can share one loaded graph. Give every thread its own.
+
+    Each label carries the generation it was written in, and one from an
+    older generation reads as unreached. reset() only starts a new
+    generation, so a search pays for the nodes it touches rather than
+    clearing all of them first.
+*/
+class SearchContext
+{
+public:
+    // every node unreached, for a graph of n vertices
+    void reset(int n)
+    {
+        if ((int)labels.size() < n)
+        {
+            labels.resize(n);
+            stamp.resize(n, 0);
+        }
+        count = n;
+
+        if (++generation == 0) // wrapped around, old stamps could look current
+        {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+    }
+
+    int size() const
+    {
+        return count;
+    }
+
+    Node &operator[](int v)
+    {
+        if (stamp[v] != generation)
+            clear(v);
+        return labels[v];
+    }
+
+    const Node &operator[](int v) const
+    {
+        if (stamp[v] != generation)
+            return unreached();
+        return labels[v];
+    }
+
+private:
+    std::vector<Node> labels;
+    std::vector<uint32_t> stamp; // generation labels[v] was written in
+    uint32_t generation = 0;
+    int count = 0;
+
+    // out of line, so the test above is all that is inlined into the search loops
+    void clear(int v)
+    {
+        stamp[v] = generation;
+        labels[v] = unreached();
+    }
+
+    static const Node &unreached()
+    {
+        static const Node node = {INT_MAX, -1, -1, INT_MAX, 0};
+        return node;
+    }
+};
+
+// No goal direction: plain Dijkstra
+struct ZeroPotential
+{
+    double operator()(int) const
+    {
+        return 0;
+    }
+};
+
+/*
+    The timed problems search states (vertex, layer) instead of vertices.
+    The layer is the timetabled mode the traveller is riding on arriving
+    at the vertex, or 0 on foot or by car; those need no timetable, so
+    arriving by either leaves the same choices. Riding on never waits,
+    boarding any other metro or bus waits for its next departure, which
+    must fall in service hours. What a move costs therefore depends only on
+    the state it starts from, never on which way into the vertex happened
+    to be cheapest, and a vertex reached on foot and by metro keeps both.
+
+    Layer 0 of v is state v, so a search that never boards keeps its
+    labels where dijkstraTo() would. The riding layers of a vertex are
+    made only when a search first reaches it on a metro or bus, as a block
+    of states after the n vertices with the layer in the low bits; few
+    vertices lie on a route (about 700 of Dhaka's 46000), so the blocks
+    stay a small, dense range instead of every vertex carrying a state per
+    mode.
+*/
+class StateSpace
+{
+public:
+    int count = 1;          // layers, 0 and one per timetabled mode of the problem
+    int layer[6] = {};      // of each mode, 0 without a timetable
+    int mode[8] = {};       // of each layer
+    int runsEvery[8] = {};  // of each layer's mode
+
+    // no states made yet, for `problem` over a graph of n vertices
+    void reset(const ProblemSpec &problem, int n)
+    {
+        count = 1;
+        bits = 0;
+        for (int m = 1; m <= 5; m++)
+        {
+            layer[m] = 0;
+            if ((problem.modes >> m & 1) && problem.runsEvery[m])
+            {
+                layer[m] = count;
+                mode[count] = m;
+                runsEvery[count] = problem.runsEvery[m];
+                count++;
+            }
+        }
+        while ((1 << bits) < count)
+            bits++;
+
+        vertices = n;
+        if ((int)block.size() < n)
+        {
+            block.resize(n);
+            stamp.resize(n, 0);
+        }
+        blockVertex.clear();
+
+        if (++generation == 0) // wrapped around, old stamps could look current
+        {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            generation = 1;
+        }
+    }
+
+    // IDs any state can have, made or not
+    int capacity() const
+    {
+        return vertices + (vertices << bits);
+    }
+
+    // state of v in `layer`, made on first use
+    int state(int v, int layer)
+    {
+        if (layer == 0)
+            return v;
+        if (stamp[v] != generation)
+        {
+            stamp[v] = generation;
+            block[v] = blockVertex.size();
+            blockVertex.push_back(v);
+        }
+        return vertices + (block[v] << bits | layer);
+    }
+
+    // state of v in `layer`, -1 when it was never made
+    int find(int v, int layer) const
+    {
+        if (layer == 0)
+            return v;
+        return stamp[v] == generation ? vertices + (block[v] << bits | layer) : -1;
+    }
+
+    int vertexOf(int state) const
+    {
+        return state < vertices ? state : blockVertex[(state - vertices) >> bits];
+    }
+
+    int layerOf(int state) const
+    {
+        return state < vertices ? 0 : (state - vertices) & ((1 << bits) - 1);
+    }
+
+private:
+    int bits = 0;
+    int vertices = 0;
+    std::vector<int> block;      // of each vertex with riding states
+    std::vector<uint32_t> stamp; // generation block[v] was made in
+    std::vector<int> blockVertex;
+    uint32_t generation = 0;
+};
+
+/*
+    true when label `by` leaves label `x` of the same vertex nothing to add:
+    no dearer and no later, and when x rides on one that runs every
+    `runsEvery`, by has to board it no later and inside service hours.
+
+    Nobody waits for the first departure, so before service hours a later
+    label could board where an earlier one is too early. Within the
+    shortest headway of SERVICE_START that cannot happen, every label
+    catches the first departure, and earlier is always better. Before
+    that the earlier label is still taken as better: keeping every arrival
+    time of every road path instead would grow the sets without bound.
+*/
+inline bool stateDominates(const Node &by, const Node &x, int runsEvery)
+{
+    if (by.cost > x.cost || by.arrivalTime > x.arrivalTime)
+        return false;
+    if (!runsEvery)
+        return true;
+
+    double boarding = by.arrivalTime + waitingTime(by.arrivalTime, runsEvery);
+    return boarding <= x.arrivalTime && boarding >= SERVICE_START && boarding <= SERVICE_END;
+}
+
+// Labels `nodes` along `trip` ((vertex, label) from the source on), leaving out any loop back to a vertex already on the way
+inline void writeTrip(const std::vector<std::pair<int, Node>> &trip, SearchContext &nodes)
+{
+    // the first visit is kept, the time the loop took is spent waiting there instead
+    static thread_local std::vector<int> position;
+    std::vector<int> kept;
+    for (int k = 0; k < (int)trip.size(); k++)
+    {
+        int v = trip[k].first;
+        if ((int)position.size() <= v)
+            position.resize(v + 1, -1);
+
+        if (position[v] != -1)
+        {
+            for (size_t i = position[v] + 1; i < kept.size(); i++)
+                position[trip[kept[i]].first] = -1;
+            kept.resize(position[v] + 1);
+            continue;
+        }
+        position[v] = kept.size();
+        kept.push_back(k);
+    }
+
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+        int v = trip[kept[i]].first;
+        position[v] = -1;
+
+        nodes[v] = trip[kept[i]].second;
+        nodes[v].prev = i ? trip[kept[i - 1]].first : -1;
+        if (i && kept[i] != kept[i - 1] + 1)
+            nodes[v].waiting += trip[kept[i] - 1].second.arrivalTime - trip[kept[i - 1]].second.arrivalTime;
+    }
+}
+
+/*
+    A lower bound on what is left from a vertex to dst for
+    stateDijkstraTo(): costWeight times the problem's cost plus perMinute
+    times the travel time, without waiting for any vehicle, so never more
+    than any trip really takes.
+
+    reset() runs A* back from dst to src, walking the edges leaving a
+    vertex as if they entered it like bidirectionalDijkstra() does, with
+    the straight line to src as the potential. The vertices it settled
+    have their exact value. Any other vertex v is worth at least the last
+    key settled less v's potential, or else A* would have settled it, and
+    at least the straight line to dst; the search never goes on past src,
+    so it covers the corridor between the two and not a disc around dst.
+*/
+template <class Queue = QuadHeap>
+class BoundTo
+{
+public:
+    // false when src cannot reach dst, the vertices that cannot are then worth INT_MAX
+    bool reset(const ProblemSpec &problem, int src, int dst, const QueryGraph &graph, double costWeight, double perMinute)
+    {
+        this->graph = &graph;
+        this->src = src;
+        from = graph.lonLat(src);
+        to = graph.lonLat(dst);
+
+        // the cheapest km of any mode, a hair less as split edges are a share of their segment's length
+        perKM = std::numeric_limits<double>::infinity();
+        for (int mode = 1; mode <= 5; mode++)
+            if ((problem.modes >> mode & 1) && problem.speed[mode] > 0)
+                perKM = std::min(perKM, costWeight * edgeWeight(problem, 1, mode) + perMinute * 60.0 / problem.speed[mode]);
+        perKM *= 1 - 1e-4;
+
+        int n = graph.vertexCount();
+        left.reset(n);
+        left[dst].cost = 0;
+        if ((int)along.size() < n)
+            along.resize(n);
+        along[dst] = {0, 0};
+        queue.reset(n);
+        queue.push(dst, perKM * haversine(to, from));
+
+        exhausted = false;
+        while (!queue.empty())
+        {
+            std::pair<double, int> top = queue.pop();
+            settledKey = top.first;
+            int v = top.second;
+            if (v == src)
+                return true;
+
+            for (int e : graph.edges(v))
+            {
+                int mode = graph.mode(e);
+                if (!(problem.modes >> mode & 1))
+                    continue;
+
+                int u = graph.target(e);
+                double cost = left[v].cost + costWeight * edgeWeight(problem, graph.length(e), mode) +
+                              perMinute * graph.length(e) / problem.speed[mode] * 60.0;
+                if (left[u].cost > cost)
+                {
+                    left[u].cost = cost;
+                    along[u] = {along[v].first + edgeWeight(problem, graph.length(e), mode),
+                                along[v].second + graph.length(e) / problem.speed[mode] * 60.0};
+                    queue.push(u, cost + perKM * haversine(graph.lonLat(u), from));
+                }
+            }
+        }
+        exhausted = true;
+        return false;
+    }
+
+    // fare and minutes of the path found from src, after reset() returned true
+    std::pair<double, double> path() const
+    {
+        return along[src];
+    }
+
+    double operator()(int v)
+    {
+        if (queue.done(v))
+            return left[v].cost;
+        if (exhausted)
+            return INT_MAX;
+        std::pair<double, double> at = graph->lonLat(v);
+        return std::max(settledKey - perKM * haversine(at, from), perKM * haversine(at, to));
+    }
+
+private:
+    const QueryGraph *graph = nullptr;
+    int src = -1;
+    std::pair<double, double> from, to;
+    double perKM = 0, settledKey = 0;
+    bool exhausted = false; // the search ran out before src
+    SearchContext left;
+    std::vector<std::pair<double, double>> along; // fare and minutes of the path to each reached vertex
+    Queue queue;
+};
+
+// Deadline bounds stateDijkstraTo() may search back for per query, beyond the time and the cost left
+const int TRADE_BOUNDS = 4;
+
+/*
+    dijkstraTo() for the timed problems, over (vertex, layer) states. The
+    first label of a vertex to settle is its best, and is what `nodes`
+    gets for that vertex. For a single target the path to it is then
+    written along its own labels, so extractPath(), prevEdge and waiting
+    describe exactly the trip that was costed; with several targets the
+    targets' costs and times are exact, paths may mix labels.
+
+    Cost with a deadline or service hours is really two criteria: a
+    cheaper label that arrives later can miss the deadline or the last
+    departure an earlier one still makes. So a state keeps every label no
+    other of its labels is as cheap and as early as (a Pareto set), and
+    they settle one by one in order of cost, see stateDominates() for
+    before service hours. For Problem 5 cost is the arrival, so a set
+    holds one label.
+
+    Towards a single target BoundTo keeps the sets small. A label that
+    cannot make the deadline even without waiting is dropped. For the fare
+    problems the potential is the most of: the cost left; with a deadline,
+    the cost plus `perMinute` Tk per minute left, less what the minutes to
+    spare are worth at that rate, for a few rates; and once service hours
+    are over, for a label not aboard a vehicle, the cost left by road. The
+    rates come from the cheapest and the fastest path at src, the fare one
+    would give for the minutes the other saves, then from the paths each
+    rate finds in between, so a label that has to hurry is as dear as the
+    fast modes it needs and nothing dearer than the answer is settled.
+*/
+template <class Queue = QuadHeap, class Potential = ZeroPotential>
+inline int stateDijkstraTo(const ProblemSpec &problem, int src, const std::vector<int> &targets, SearchContext &nodes, const QueryGraph &graph,
+                           double startingTime, double scheduledTime, Potential potential = Potential())
+{
+    int n = graph.vertexCount();
+    nodes.reset(n);
+
+    static thread_local StateSpace space;
+    space.reset(problem, n);
+
+    int rideOf[6];
+    std::copy(space.layer, space.layer + 6, rideOf);
+
+    // every label made, prev is the parent label; and per state the labels still in its set
+    struct Label
+    {
+        Node node;
+        double key; // cost plus what is left at least
+        int state;
+        bool settled;
+    };
+    static thread_local std::vector<Label> labels;
+    static thread_local std::vector<std::vector<int>> sets;
+    static thread_local std::vector<int> touched;
+    labels.clear();
+    if ((int)sets.size() < space.capacity())
+        sets.resize(space.capacity());
+
+    // label of a set to settle next, of equal keys the earliest; -1 when all are settled
+    auto nextLabel = [&](const std::vector<int> &set) {
+        int best = -1;
+        for (int i : set)
+            if (!labels[i].settled && (best == -1 || labels[i].key < labels[best].key ||
+                                       (labels[i].key == labels[best].key && labels[i].node.arrivalTime < labels[best].node.arrivalTime)))
+                best = i;
+        return best;
+    };
+
+    // targets not settled yet, cleared again on the way out
+    static thread_local std::vector<char> isTarget;
+    if ((int)isTarget.size() < n)
+        isTarget.resize(n, 0);
+
+    int targetsLeft = 0;
+    for (int t : targets)
+        if (t >= 1 && t < n && !isTarget[t])
+        {
+            isTarget[t] = 1;
+            targetsLeft++;
+        }
+
+    // towards a single target: the minutes left with a deadline, the cost left for the fare problems
+    static thread_local BoundTo<Queue> timeLeft, costLeft[TRADE_BOUNDS];
+    double perMinute[TRADE_BOUNDS];
+    int trades = 0;
+    bool single = targets.size() == 1 && targets[0] >= 1 && targets[0] < n;
+    bool timeBound = single && scheduledTime != std::numeric_limits<double>::infinity();
+    bool reachable = true;
+    if (timeBound)
+        reachable = timeLeft.reset(problem, src, targets[0], graph, 0, 1) && startingTime + timeLeft(src) <= scheduledTime;
+
+    if (single && problem.objective == MIN_COST && reachable)
+    {
+        perMinute[trades] = 0;
+        reachable = costLeft[trades++].reset(problem, src, targets[0], graph, 1, 0);
+
+        // the cheapest and the fastest path at src span the trade, each bound's path makes it more precise
+        std::pair<double, double> cheap = costLeft[0].path(), fast = timeBound ? timeLeft.path() : cheap;
+        double spare = scheduledTime - startingTime;
+        while (reachable && trades < TRADE_BOUNDS && cheap.second > spare && cheap.second > fast.second && fast.first > cheap.first)
+        {
+            perMinute[trades] = (fast.first - cheap.first) / (cheap.second - fast.second);
+            BoundTo<Queue> &bound = costLeft[trades++];
+            bound.reset(problem, src, targets[0], graph, 1, perMinute[trades - 1]);
+
+            std::pair<double, double> found = bound.path();
+            if (found.second <= fast.second + 1e-9 || found.second >= cheap.second - 1e-9)
+                break;
+            (found.second > spare ? cheap : fast) = found;
+        }
+    }
+
+    // after service hours nothing can be boarded, so labels off any vehicle then have the road modes alone
+    static thread_local BoundTo<Queue> roadLeft;
+    bool roadBound = false;
+    if (single && problem.objective == MIN_COST && reachable && scheduledTime > SERVICE_END)
+    {
+        ProblemSpec road = problem;
+        for (int mode = 1; mode <= 5; mode++)
+            if (road.runsEvery[mode])
+                road.modes &= ~(1u << mode);
+        roadBound = road.modes != problem.modes;
+        if (roadBound)
+            roadLeft.reset(road, src, targets[0], graph, 1, 0);
+    }
+
+    auto key = [&](int v, double cost, double arrivalTime, bool aboard) {
+        double left = potential(v);
+        for (int k = 0; k < trades; k++)
+            left = std::max(left, costLeft[k](v) - (perMinute[k] ? perMinute[k] * (scheduledTime - arrivalTime) : 0));
+        if (roadBound && !aboard && arrivalTime > SERVICE_END)
+            left = std::max(left, roadLeft(v));
+        return cost + left;
+    };
+
+    double srcCost = problem.objective == MIN_ARRIVAL ? startingTime : 0;
+    labels.push_back({Node{srcCost, -1, -1, startingTime, 0}, key(src, srcCost, startingTime, false), src, false});
+    sets[src].push_back(0);
+    touched.push_back(src);
+
+    static thread_local Queue queue;
+    queue.reset(space.capacity());
+    if (reachable)
+        queue.push(src, labels[0].key);
+
+    int settled = 0, lastTarget = -1;
+    while (!queue.empty())
+    {
+        int s = queue.pop().second;
+        int i = nextLabel(sets[s]);
+        if (i == -1)
+            continue;
+        labels[i].settled = true;
+
+        int v = space.vertexOf(s), layer = space.layerOf(s), riding = space.mode[layer];
+        int after = nextLabel(sets[s]);
+        if (after != -1)
+            queue.push(s, labels[after].key);
+        Node at = labels[i].node;
+
+        // a label settled in another layer of v as good as this one leaves it nothing, or only riding on, to do
+        bool dominated = false, rideOnly = false;
+        for (int l = 0; l < space.count && !dominated; l++)
+        {
+            int other = l == layer ? -1 : space.find(v, l);
+            if (other == -1)
+                continue;
+            for (int k : sets[other])
+                if (labels[k].settled)
+                {
+                    dominated = dominated || stateDominates(labels[k].node, at, space.runsEvery[layer]);
+                    rideOnly = rideOnly || stateDominates(labels[k].node, at, 0);
+                }
+        }
+        if (dominated)
+            continue;
+        settled++;
+
+        if (nodes[v].cost == INT_MAX)
+        {
+            nodes[v] = at;
+            nodes[v].prev = at.prev == -1 ? -1 : space.vertexOf(labels[at.prev].state);
+            if (isTarget[v])
+            {
+                isTarget[v] = 0;
+                lastTarget = i;
+                if (--targetsLeft == 0)
+                    break;
+            }
+        }
+
+        for (int e : graph.edges(v))
+        {
+            int mode = graph.mode(e);
+            if (!(problem.modes >> mode & 1) || (rideOnly && mode != riding))
+                continue;
+
+            // boarding a metro or bus means waiting for the next one, inside service hours
+            double waiting = 0;
+            if (problem.runsEvery[mode] && mode != riding)
+            {
+                waiting = waitingTime(at.arrivalTime, problem.runsEvery[mode]);
+
+                double boarding = at.arrivalTime + waiting;
+                if (boarding < SERVICE_START || boarding > SERVICE_END)
+                    continue;
+            }
+
+            int u = graph.target(e);
+            double dist_vu = graph.length(e); // km
+            double arrivalTime = at.arrivalTime + (dist_vu / problem.speed[mode]) * 60.0 + waiting;
+            if (arrivalTime > scheduledTime || (timeBound && arrivalTime + timeLeft(u) > scheduledTime))
+                continue;
+
+            double cost = problem.objective == MIN_ARRIVAL ? arrivalTime : at.cost + edgeWeight(problem, dist_vu, mode);
+            Node label{cost, i, e, arrivalTime, waiting};
+
+            int next = u, ride = rideOf[mode];
+            bool kept = true;
+            if (ride)
+            {
+                // riding into a vertex already settled on foot no later and for no more is not worth a state
+                for (int k : sets[u])
+                    kept = kept && !(labels[k].settled && stateDominates(labels[k].node, label, space.runsEvery[ride]));
+                next = space.state(u, ride);
+            }
+
+            // into the set unless one of its labels is as good, pushing out the unsettled ones it beats
+            std::vector<int> &set = sets[next];
+            for (size_t k = 0; k < set.size() && kept; k++)
+                kept = !stateDominates(labels[set[k]].node, label, 0);
+            if (!kept)
+                continue;
+
+            double labelKey = key(u, cost, arrivalTime, ride != 0);
+            if (labelKey >= INT_MAX)
+                continue;
+
+            if (set.empty())
+                touched.push_back(next);
+            set.erase(std::remove_if(set.begin(), set.end(), [&](int k) { return !labels[k].settled && stateDominates(label, labels[k].node, 0); }),
+                      set.end());
+            set.push_back(labels.size());
+            labels.push_back({label, labelKey, next, false});
+            queue.push(next, labelKey);
+        }
+    }
+
+    for (int t : targets)
+        if (t >= 1 && t < n)
+            isTarget[t] = 0;
+    for (int s : touched)
+        sets[s].clear();
+    touched.clear();
+
+    // the trip to a single target along its own labels
+    if (targets.size() == 1 && lastTarget != -1)
+    {
+        std::vector<std::pair<int, Node>> trip;
+        for (int i = lastTarget; i != -1; i = labels[i].node.prev)
+            trip.push_back({space.vertexOf(labels[i].state), labels[i].node});
+        std::reverse(trip.begin(), trip.end());
+        writeTrip(trip, nodes);
+    }
+    return settled;
+}
+
+/*
+    Dijkstra from src over `graph` for `problem`, stopping as soon as every
+    vertex in `targets` is settled (an empty list searches the whole graph).
+    Unreachable nodes keep cost INT_MAX; after an early stop only the
+    targets, and the nodes on their paths, are final. Timed problems start
+    at `startingTime` and, for Problem 6, only use edges that arrive by
+    `scheduledTime`. `nodes` is reset for the query graph, so one context
+    can serve any number of queries. Returns the number of nodes settled.
+
+    Only reached nodes enter the queue, a short query never touches the
+    queue for the rest of the graph. Queue is any of PriorityQueue.h.
+
+    `potential(v)` turns the search into A*: nodes are settled in order of
+    cost + potential, which must never overestimate the remaining cost to
+    the (single) target. A node whose label improves after it was settled
+    is queued again, so a potential that is admissible but not quite
+    consistent still gives exact paths.
+
+    The queue is kept per thread between searches, like the labels in
+    `nodes`, so a short search never pays for the whole graph. Timed
+    problems are searched over (vertex, mode) states, see stateDijkstraTo().
+*/
+template <class Queue = QuadHeap, class Potential = ZeroPotential>
+inline int dijkstraTo(const ProblemSpec &problem, int src, const std::vector<int> &targets, SearchContext &nodes, const QueryGraph &graph,
+                      double startingTime = 0, double scheduledTime = std::numeric_limits<double>::infinity(),
+                      Potential potential = Potential())
+{
+    if (problem.timed)
+        return stateDijkstraTo<Queue>(problem, src, targets, nodes, graph, startingTime, scheduledTime, potential);
+
+    nodes.reset(graph.vertexCount());
+
+    nodes[src].cost = problem.objective == MIN_ARRIVAL ? startingTime : 0;
+    nodes[src].arrivalTime = startingTime;
+
+    // targets not settled yet, cleared again on the way out
+    static thread_local std::vector<char> isTarget;
+    if ((int)isTarget.size() < nodes.size())
+        isTarget.resize(nodes.size(), 0);
+
+    int targetsLeft = 0;
+    for (int t : targets)
+        if (t >= 1 && t < nodes.size() && !isTarget[t])
+        {
+            isTarget[t] = 1;
+            targetsLeft++;
+        }
+
+    static thread_local Queue queue;
+    queue.reset(nodes.size());
+    queue.push(src, nodes[src].cost + potential(src));
+
+    int settled = 0;
+    while (!queue.empty())
+    {
+        int v = queue.pop().second;
+        settled++;
+
+        if (isTarget[v])
+        {
+            isTarget[v] = 0;
+            if (--targetsLeft == 0)
+                break;
+        }
+
+        for (int e : graph.edges(v))
+        {
+            int mode = graph.mode(e);
+            if (!(problem.modes >> mode & 1))
+                continue;
+
+            int u = graph.target(e);
+            double cost = nodes[v].cost + edgeWeight(problem, graph.length(e), mode);
+
+            // a settled node never improves without a potential, costs only grow along a path
+            if (nodes[u].cost > cost)
+            {
+                nodes[u].cost = cost;
+                nodes[u].prev = v;
+                nodes[u].prevEdge = e;
+                nodes[u].arrivalTime = 0;
+                nodes[u].waiting = 0;
+
+                queue.push(u, cost + potential(u));
+            }
+        }
+    }
+
+    for (int t : targets)
+        if (t >= 1 && t < nodes.size())
+            isTarget[t] = 0;
+
+    return settled;
+}
+
+// Point to point: stops once dst is settled
+template <class Queue = QuadHeap>
+inline int dijkstraTo(const ProblemSpec &problem, int src, int dst, SearchContext &nodes, const QueryGraph &graph,
+                      double startingTime = 0, double scheduledTime = std::numeric_limits<double>::infinity())
+{
+    return dijkstraTo<Queue>(problem, src, std::vector<int>(1, dst), nodes, graph, startingTime, scheduledTime);
+}
+
+// Shortest paths from src to every node
+template <class Queue = QuadHeap>
+inline int dijkstra(const ProblemSpec &problem, int src, SearchContext &nodes, const QueryGraph &graph,
+                    double startingTime = 0, double scheduledTime = std::numeric_limits<double>::infinity())
+{
+    return dijkstraTo<Queue>(problem, src, std::vector<int>(), nodes, graph, startingTime, scheduledTime);
+}
+
+// Vertices from the search source to dst, empty when dst was not reached
+inline std::vector<int> extractPath(const SearchContext &nodes, int dst)
+{
+    std::vector<int> path;
+    if (nodes[dst].cost == INT_MAX)
+        return path;
+
+    for (int ID = dst; ID != -1; ID = nodes[ID].prev)
+        path.push_back(ID);
+
+    std::reverse(path.begin(), path.end());
+    return path;
+}
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "MappedFile.h"
+
+/*
+    Binary graph snapshot written by graph-compile.
+
+        SnapshotHeader
+        SnapshotSection[sectionCount]
+        section data, every section starting on a 64 byte boundary
+
+    The checksum covers every byte after the header. Arrays are stored in
+    the machine's native layout, the snapshot is meant to be compiled and
+    read on the same kind of machine. Loading maps the file read-only and
+    points the CSRGraph arrays straight into the mapping, nothing is parsed
+    or copied.
+
+    Bump SNAPSHOT_VERSION whenever the meaning of a section changes, old
+    snapshots are then rejected and the programs fall back to the CSV files.
+*/
+
+const uint32_t SNAPSHOT_VERSION = 1;
+const char SNAPSHOT_MAGIC[8] = {'D', 'H', 'K', 'G', 'R', 'A', 'P', 'H'};
+
+enum SnapshotSectionID : uint32_t
+{
+    SECTION_OFFSET = 1, // int[vertices + 1]
+    SECTION_TARGET = 2, // int[edges]
+    SECTION_LENGTH = 3, // double[edges], km
+    SECTION_MODE = 4,   // unsigned char[edges]
+    SECTION_LON = 5,    // double[vertices]
+    SECTION_LAT = 6,    // double[vertices]
+
+    // optional, ALT tables (Landmarks.h)
+    SECTION_LANDMARK_PROBLEMS = 7,  // int[metrics], the problem each table measures
+    SECTION_LANDMARK_VERTICES = 8,  // int[metrics * landmarks]
+    SECTION_LANDMARK_DISTANCES = 9, // float[metrics * vertices * landmarks]
+    SECTION_LANDMARK_TABLES = 10,   // uint64_t[metrics], metricFingerprint() of each problem when measured
+
+    // optional, Contraction Hierarchies (ContractionHierarchy.h)
+    SECTION_CH_PROBLEMS = 11, // int[metrics], the problem each hierarchy was contracted for
+    SECTION_CH_TABLES = 12,   // uint64_t[metrics], metricFingerprint() of each problem when contracted
+    SECTION_CH_OFFSET = 13,   // int[metrics * (vertices + 1)], upward arcs of each vertex
+    SECTION_CH_TARGET = 14,   // int[arcs]
+    SECTION_CH_WEIGHT = 15,   // double[arcs]
+    SECTION_CH_MIDDLE = 16,   // int[arcs], vertex a shortcut bypasses, -1 for a graph edge
+
+    // optional, topology of the customizable hierarchy (Customizable.h)
+    SECTION_CCH_ORDER = 17,  // int[vertices], order of contraction
+    SECTION_CCH_OFFSET = 18, // int[vertices + 1], upward arcs of each vertex
+    SECTION_CCH_TARGET = 19, // int[arcs]
+
+    // optional, hub labels (HubLabels.h)
+    SECTION_HUB_PROBLEMS = 20, // int[metrics]
+    SECTION_HUB_TABLES = 21,   // uint64_t[metrics], metricFingerprint() of each problem when labelled
+    SECTION_HUB_OFFSET = 22,   // int64_t[metrics * (vertices + 1)], label of each vertex
+    SECTION_HUB_HUB = 23,      // int[entries], INT_MAX pads
+    SECTION_HUB_COST = 24,     // double[entries]
+    SECTION_HUB_PARENT = 25,   // int[entries]
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+    uint64_t checksum;
+};
+
+struct SnapshotSection
+{
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset; // from the start of the file
+    uint64_t count;  // number of elements
+};
+
+// 64 bit multiply-xor hash over 8 byte words, fast enough to run on every load
+inline uint64_t snapshotChecksum(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+
+    return hash;
+}
+
+class SnapshotWriter
+{
+public:
+    template <class T>
+    void add(uint32_t id, const T *data, size_t count)
+    {
+        sections.push_back({id, (uint32_t)sizeof(T), 0, count});
+        payloads.push_back({(const unsigned char *)data, count * sizeof(T)});
+    }
+
+    bool write(const std::string &path, std::string &error) const
+    {
+        size_t tableEnd = sizeof(SnapshotHeader) + sections.size() * sizeof(SnapshotSection);
+
+        std::vector<SnapshotSection> table = sections;
+        size_t fileSize = tableEnd;
+        for (size_t i = 0; i < table.size(); i++)
+        {
+            fileSize = align(fileSize);
+            table[i].offset = fileSize;
+            fileSize += payloads[i].second;
+        }
+
+        std::vector<unsigned char> bytes(fileSize, 0);
+        memcpy(bytes.data() + sizeof(SnapshotHeader), table.data(), table.size() * sizeof(SnapshotSection));
+        for (size_t i = 0; i < table.size(); i++)
+            if (payloads[i].second)
+                memcpy(bytes.data() + table[i].offset, payloads[i].first, payloads[i].second);
+
+        SnapshotHeader header;
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.sectionCount = table.size();
+        header.fileSize = fileSize;
+        header.checksum = snapshotChecksum(bytes.data() + sizeof(SnapshotHeader), fileSize - sizeof(SnapshotHeader));
+        memcpy(bytes.data(), &header, sizeof(header));
+
+        // write next to the target and rename, readers never see half a file
+        std::string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out.is_open())
+        {
+            error = "cannot create " + temporary;
+            return false;
+        }
+        out.write((const char *)bytes.data(), bytes.size());
+        out.close();
+
+        if (!out || rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<SnapshotSection> sections;
+    std::vector<std::pair<const unsigned char *, size_t>> payloads;
+
+    static size_t align(size_t offset)
+    {
+        return (offset + 63) / 64 * 64;
+    }
+};
+
+// A validated, read-only mapping of a snapshot file
+class Snapshot
+{
+public:
+    static std::shared_ptr<const Snapshot> open(const std::string &path, std::string &error)
+    {
+        std::shared_ptr<Snapshot> snapshot(new Snapshot());
+        if (!snapshot->file.open(path, error))
+            return nullptr;
+
+        if (!snapshot->validate(error))
+            return nullptr;
+
+        return snapshot;
+    }
+
+    // pointer to the section's first element, nullptr when the section is absent or has another element type
+    template <class T>
+    const T *section(uint32_t id, size_t &count) const
+    {
+        for (uint32_t i = 0; i < header()->sectionCount; i++)
+        {
+            const SnapshotSection &entry = table()[i];
+            if (entry.id == id && entry.elementSize == sizeof(T))
+            {
+                count = entry.count;
+                return (const T *)(bytes() + entry.offset);
+            }
+        }
+        count = 0;
+        return nullptr;
+    }
+
+private:
+    MappedFile file;
+
+    Snapshot() {}
+
+    const unsigned char *bytes() const
+    {
+        return (const unsigned char *)file.data();
+    }
+
+    const SnapshotHeader *header() const
+    {
+        return (const SnapshotHeader *)file.data();
+    }
+
+    const SnapshotSection *table() const
+    {
+        return (const SnapshotSection *)(bytes() + sizeof(SnapshotHeader));
+    }
+
+    bool validate(std::string &error) const
+    {
+        size_t size = file.size();
+        if (size < sizeof(SnapshotHeader))
+        {
+            error = "truncated file";
+            return false;
+        }
+        if (memcmp(header()->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        {
+            error = "not a graph snapshot";
+            return false;
+        }
+        if (header()->version != SNAPSHOT_VERSION)
+        {
+            error = "snapshot version " + std::to_string(header()->version) + ", expected " + std::to_string(SNAPSHOT_VERSION);
+            return false;
+        }
+        if (header()->fileSize != size || sizeof(SnapshotHeader) + (size_t)header()->sectionCount * sizeof(SnapshotSection) > size)
+        {
+            error = "truncated file";
+            return false;
+        }
+        if (snapshotChecksum(bytes() + sizeof(SnapshotHeader), size - sizeof(SnapshotHeader)) != header()->checksum)
+        {
+            error = "checksum mismatch";
+            return false;
+        }
+        for (uint32_t i = 0; i < header()->sectionCount; i++)
+        {
+            const SnapshotSection &entry = table()[i];
+            if (entry.elementSize == 0 || entry.offset % 64 || entry.offset > size || entry.count > (size - entry.offset) / entry.elementSize)
+            {
+                error = "section " + std::to_string(entry.id) + " out of bounds";
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+inline void addGraphSections(SnapshotWriter &writer, const CSRGraph &graph)
+{
+    writer.add(SECTION_OFFSET, graph.offset, graph.vertexCount() + 1);
+    writer.add(SECTION_TARGET, graph.target, graph.edgeCount());
+    writer.add(SECTION_LENGTH, graph.length, graph.edgeCount());
+    writer.add(SECTION_MODE, graph.mode, graph.edgeCount());
+    writer.add(SECTION_LON, graph.lon, graph.vertexCount());
+    writer.add(SECTION_LAT, graph.lat, graph.vertexCount());
+}
+
+// Points the graph arrays into the mapped snapshot, the graph keeps the mapping alive
+inline bool readGraphSections(const std::shared_ptr<const Snapshot> &snapshot, CSRGraph &graph, std::string &error)
+{
+    size_t offsets, targets, lengths, modes, lons, lats;
+
+    graph.offset = snapshot->section<int>(SECTION_OFFSET, offsets);
+    graph.target = snapshot->section<int>(SECTION_TARGET, targets);
+    graph.length = snapshot->section<double>(SECTION_LENGTH, lengths);
+    graph.mode = snapshot->section<unsigned char>(SECTION_MODE, modes);
+    graph.lon = snapshot->section<double>(SECTION_LON, lons);
+    graph.lat = snapshot->section<double>(SECTION_LAT, lats);
+
+    if (!graph.offset || !graph.target || !graph.length || !graph.mode || !graph.lon || !graph.lat ||
+        offsets != lons + 1 || lats != lons || lengths != targets || modes != targets ||
+        graph.offset[lons] != (int)targets)
+    {
+        graph = CSRGraph();
+        error = "graph sections are missing or inconsistent";
+        return false;
+    }
+
+    graph.vertices = lons;
+    graph.edges = targets;
+    graph.storage = snapshot;
+    graph.buildIndexes();
+    return true;
+}
@@ -0,0 +1,251 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "Geo.h"
+
+// Longitude / latitude rectangle, a point is a box with west == east and south == north
+struct GeoBox
+{
+    double west, south, east, north;
+
+    static GeoBox point(std::pair<double, double> lon_lat)
+    {
+        return {lon_lat.first, lon_lat.second, lon_lat.first, lon_lat.second};
+    }
+
+    static GeoBox segment(std::pair<double, double> a, std::pair<double, double> b)
+    {
+        return {std::min(a.first, b.first), std::min(a.second, b.second), std::max(a.first, b.first), std::max(a.second, b.second)};
+    }
+
+    // a box that is not indexed (e.g. the unused vertex 0)
+    static GeoBox none()
+    {
+        return {1, 1, 0, 0};
+    }
+
+    bool empty() const
+    {
+        return west > east || south > north;
+    }
+};
+
+/*
+    Uniform grid over the bounding box of a set of items (graph vertices or
+    road segments), for nearest-item queries without scanning every item.
+
+    Cells are about square on the ground and sized for ~2 items each; an
+    item is listed in every cell its box overlaps. A query visits rings of
+    cells around the query's cell, nearest ring first, and ranks the items
+    found by the caller's exact distance. Each cell has a lower bound on
+    the haversine distance to anything inside it, so cells that cannot
+    beat the current k-th best are skipped and the search stops at the
+    first ring where no cell can. For points ranked by haversine the result
+    is exactly what a linear scan gives, ties going to the smaller ID.
+*/
+class SpatialIndex
+{
+public:
+    SpatialIndex() {}
+
+    explicit SpatialIndex(const std::vector<GeoBox> &boxes, int perCell = 2)
+    {
+        bool first = true;
+        int count = 0;
+        for (const GeoBox &box : boxes)
+        {
+            if (box.empty())
+                continue;
+
+            if (first)
+            {
+                minLon = box.west, maxLon = box.east, minLat = box.south, maxLat = box.north;
+                first = false;
+            }
+            minLon = std::min(minLon, box.west);
+            maxLon = std::max(maxLon, box.east);
+            minLat = std::min(minLat, box.south);
+            maxLat = std::max(maxLat, box.north);
+            count++;
+        }
+
+        if (!count)
+            return;
+
+        // cell side in degrees of latitude, longitude cells widened so both are the same length on the ground
+        double lonScale = std::max(0.01, cos((minLat + maxLat) / 2 * M_PI / 180.0));
+        double width = (maxLon - minLon) * lonScale;
+        double height = maxLat - minLat;
+        int cells = std::max(1, count / perCell);
+        double side = std::max(sqrt(width * height / cells), std::max(width, height) / cells);
+        side = std::max(side, 1e-7);
+
+        cellHeight = side;
+        cellWidth = side / lonScale;
+        cols = (int)((maxLon - minLon) / cellWidth) + 1;
+        rows = (int)((maxLat - minLat) / cellHeight) + 1;
+
+        // counting sort of the items by cell, IDs stay ascending within a cell
+        cellStart.assign(rows * cols + 1, 0);
+        forEachCell(boxes, [&](int, int cell) { cellStart[cell + 1]++; });
+        for (int c = 0; c < rows * cols; c++)
+            cellStart[c + 1] += cellStart[c];
+
+        cellItem.resize(cellStart.back());
+        std::vector<int> next(cellStart.begin(), cellStart.end() - 1);
+        forEachCell(boxes, [&](int item, int cell) { cellItem[next[cell]++] = item; });
+
+        // smallest cos(latitude) over each row, for the distance lower bound
+        rowMinCos.resize(rows);
+        for (int y = 0; y < rows; y++)
+        {
+            double south = minLat + y * cellHeight - SLACK;
+            double north = minLat + (y + 1) * cellHeight + SLACK;
+            rowMinCos[y] = std::max(0.0, std::min(cos(south * M_PI / 180.0), cos(north * M_PI / 180.0)));
+            minCos = std::min(minCos, rowMinCos[y]);
+        }
+    }
+
+    /*
+        Up to k items as (distance km, id), nearest first. distanceTo(id) is
+        the exact distance from the query point to the item, infinity to
+        leave the item out; it must never be below the haversine distance to
+        the nearest point of the item's box.
+    */
+    template <class Distance>
+    std::vector<std::pair<double, int>> nearest(std::pair<double, double> lon_lat, int k, Distance distanceTo) const
+    {
+        std::vector<std::pair<double, int>> best;
+        if (cellItem.empty() || k <= 0)
+            return best;
+
+        int qx = std::min(cols - 1, std::max(0, (int)floor((lon_lat.first - minLon) / cellWidth)));
+        int qy = std::min(rows - 1, std::max(0, (int)floor((lon_lat.second - minLat) / cellHeight)));
+        int lastRing = std::max(std::max(qx, cols - 1 - qx), std::max(qy, rows - 1 - qy));
+
+        double queryCos = std::max(0.0, cos(lon_lat.second * M_PI / 180.0));
+
+        for (int r = 0; r <= lastRing; r++)
+        {
+            double ringBound = std::numeric_limits<double>::infinity();
+
+            for (int y = qy - r; y <= qy + r; y++)
+            {
+                if (y < 0 || y >= rows)
+                    continue;
+
+                // whole rows at the top and bottom of the ring, only the two ends in between
+                int step = (y == qy - r || y == qy + r) ? 1 : std::max(1, 2 * r);
+                for (int x = qx - r; x <= qx + r; x += step)
+                {
+                    if (x < 0 || x >= cols)
+                        continue;
+
+                    ringBound = std::min(ringBound, lowerBound(lon_lat, queryCos * minCos, x, y));
+                    if (lowerBound(lon_lat, queryCos * rowMinCos[y], x, y) > kthDistance(best, k))
+                        continue;
+
+                    int cell = y * cols + x;
+                    for (int i = cellStart[cell]; i < cellStart[cell + 1]; i++)
+                    {
+                        int item = cellItem[i];
+
+                        std::pair<double, int> candidate = {distanceTo(item), item};
+                        if (candidate.first == std::numeric_limits<double>::infinity())
+                            continue;
+                        if ((int)best.size() == k && !(candidate < best.back()))
+                            continue;
+
+                        auto at = std::lower_bound(best.begin(), best.end(), candidate);
+                        if (at != best.end() && *at == candidate)
+                            continue; // seen in an earlier cell
+
+                        best.insert(at, candidate);
+                        if ((int)best.size() > k)
+                            best.pop_back();
+                    }
+                }
+            }
+
+            /*
+                With one cos factor for every row the bound only grows with
+                the gaps to the cell, so no cell further out can be closer
+                than the nearest cell of this ring.
+            */
+            if (ringBound > kthDistance(best, k))
+                break;
+        }
+
+        return best;
+    }
+
+private:
+    // cell edges computed in floating point can miss an item by a rounding error, bounds allow for it
+    static constexpr double SLACK = 1e-9;
+
+    double minLon = 0, maxLon = 0, minLat = 0, maxLat = 0;
+    double cellWidth = 1, cellHeight = 1; // degrees
+    int cols = 0, rows = 0;
+
+    std::vector<int> cellStart; // items of cell c are cellItem[cellStart[c] .. cellStart[c + 1] - 1]
+    std::vector<int> cellItem;
+    std::vector<double> rowMinCos;
+    double minCos = 1; // over all rows
+
+    int column(double lon) const
+    {
+        return std::min(cols - 1, std::max(0, (int)((lon - minLon) / cellWidth)));
+    }
+
+    int row(double lat) const
+    {
+        return std::min(rows - 1, std::max(0, (int)((lat - minLat) / cellHeight)));
+    }
+
+    template <class Visit>
+    void forEachCell(const std::vector<GeoBox> &boxes, Visit visit) const
+    {
+        for (int item = 0; item < (int)boxes.size(); item++)
+        {
+            const GeoBox &box = boxes[item];
+            if (box.empty())
+                continue;
+
+            for (int y = row(box.south); y <= row(box.north); y++)
+                for (int x = column(box.west); x <= column(box.east); x++)
+                    visit(item, y * cols + x);
+        }
+    }
+
+    static double kthDistance(const std::vector<std::pair<double, int>> &best, int k)
+    {
+        return (int)best.size() < k ? std::numeric_limits<double>::infinity() : best.back().first;
+    }
+
+    /*
+        Nothing in cell (x, y) is closer than this. Haversine grows with the
+        latitude and longitude gaps, so plugging in the smallest gaps to the
+        cell's rectangle and a cosFactor no larger than cos(query latitude) *
+        cos(latitude of the far point) never overestimates.
+    */
+    double lowerBound(std::pair<double, double> lon_lat, double cosFactor, int x, int y) const
+    {
+        double west = minLon + x * cellWidth - SLACK;
+        double east = minLon + (x + 1) * cellWidth + SLACK;
+        double south = minLat + y * cellHeight - SLACK;
+        double north = minLat + (y + 1) * cellHeight + SLACK;
+
+        double dlon = std::max(0.0, std::max(west - lon_lat.first, lon_lat.first - east)) * M_PI / 180.0;
+        double dlat = std::max(0.0, std::max(south - lon_lat.second, lon_lat.second - north)) * M_PI / 180.0;
+
+        double a = sin(dlat / 2) * sin(dlat / 2) + cosFactor * sin(dlon / 2) * sin(dlon / 2);
+        a = std::min(1.0, a);
+
+        return 2 * 6371.0 * atan2(sqrt(a), sqrt(1 - a)) * (1 - 1e-9);
+    }
+};
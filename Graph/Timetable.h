@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CSRGraph.h"
+#include "Routing.h"
+
+/*
+    The metro and bus routes of a timed problem as an explicit timetable,
+    for the timetable engines (ConnectionScan.h, Raptor.h).
+
+    The route maps only give the lines, the problems give a headway and
+    service hours per mode. A line is a stretch of one mode's route between
+    two vertices where it ends or branches (a route vertex with other than
+    two neighbours on that mode), run in both directions. Vehicles leave the
+    first stop of a line every runsEvery minutes from SERVICE_START to
+    SERVICE_END and run at the mode's speed, so a stop further down is
+    served runsEvery minutes apart at a fixed offset. A rider boards where
+    the vehicle leaves that stop inside service hours and may stay on to
+    the end of its line; going on past a branch means changing vehicles.
+
+    Every vehicle leg between two consecutive stops is a connection, all of
+    them sorted by departure. A stop is a vertex some line runs through.
+*/
+
+struct TransitLine
+{
+    int mode;
+    int runsEvery;
+    std::vector<int> stops;
+    std::vector<int> edges;      // CSR slot from stops[i] to stops[i + 1]
+    std::vector<double> offsets; // minutes from the first stop to stops[i]
+    int firstTrip;               // trips firstTrip .. firstTrip + trips - 1, leaving every runsEvery minutes
+    int trips;
+};
+
+// One vehicle from one stop to the next
+struct TransitConnection
+{
+    int from;
+    int to;
+    double departure; // minutes after midnight
+    double arrival;
+    int trip;
+    int index; // of `from` on the trip's line
+    int edge;  // CSR slot from -> to
+};
+
+struct Timetable
+{
+    std::vector<TransitLine> lines;
+    std::vector<int> tripLine;                  // line of each trip
+    std::vector<double> tripStart;              // departure from the first stop of its line
+    std::vector<TransitConnection> connections; // by departure
+
+    std::vector<int> stopVertex;                           // of each stop
+    std::vector<int> stopOf;                               // of each graph vertex, -1 off the lines
+    std::vector<std::vector<std::pair<int, int>>> serving; // (line, index) of each line through each stop
+
+    // stop at vertex v, -1 for none (query vertices included)
+    int stop(int v) const
+    {
+        return v < (int)stopOf.size() ? stopOf[v] : -1;
+    }
+
+    // first connection that leaves at `time` or later
+    int firstDeparture(double time) const
+    {
+        return std::lower_bound(connections.begin(), connections.end(), time,
+                                [](const TransitConnection &c, double t) { return c.departure < t; }) -
+               connections.begin();
+    }
+
+    // of `trip` from stop `index` of its line
+    double departure(int trip, int index) const
+    {
+        return tripStart[trip] + lines[tripLine[trip]].offsets[index];
+    }
+
+    // first trip of `line` that leaves stop `index` at `time` or later inside service hours, -1 when none does
+    int earliestTrip(int line, int index, double time) const
+    {
+        const TransitLine &l = lines[line];
+        int k = std::min<double>(l.trips, std::max(0.0, std::ceil((time - SERVICE_START - l.offsets[index]) / l.runsEvery)));
+        if (k > 0 && departure(l.firstTrip + k - 1, index) >= time) // rounding either way
+            k--;
+        else if (k < l.trips && departure(l.firstTrip + k, index) < time)
+            k++;
+        if (k >= l.trips || departure(l.firstTrip + k, index) > SERVICE_END)
+            return -1;
+        return l.firstTrip + k;
+    }
+};
+
+// Shortest CSR slot from -> to of `mode`, -1 when there is none
+inline int transitSlot(const CSRGraph &graph, int from, int to, int mode)
+{
+    int best = -1;
+    for (int e = graph.offset[from]; e < graph.offset[from + 1]; e++)
+        if (graph.target[e] == to && graph.mode[e] == mode && (best == -1 || graph.length[e] < graph.length[best]))
+            best = e;
+    return best;
+}
+
+// Follows a route from `from` over `first` to the next vertex without exactly two neighbours on it, marking the edges walked
+inline std::vector<int> traceLine(const std::vector<std::vector<int>> &neighbours, const std::vector<int> &index, int from, int first,
+                                  std::vector<std::vector<char>> &walked)
+{
+    std::vector<int> stops = {from};
+    int prev = from, v = first;
+    while (true)
+    {
+        stops.push_back(v);
+
+        // both directions of the edge prev - v
+        for (int a = 0; a < 2; a++)
+        {
+            int x = a ? v : prev, y = a ? prev : v;
+            const std::vector<int> &out = neighbours[index[x]];
+            walked[index[x]][std::find(out.begin(), out.end(), y) - out.begin()] = 1;
+        }
+
+        const std::vector<int> &next = neighbours[index[v]];
+        if (next.size() != 2 || v == from)
+            return stops;
+
+        int u = next[0] == prev ? next[1] : next[0];
+        prev = v;
+        v = u;
+    }
+}
+
+/*
+    The timetable of the timed `problem` over `graph`: lines in both
+    directions for every mode the problem runs on a headway, their trips
+    and connections. Deterministic, vertex order decides line and trip IDs.
+*/
+inline Timetable buildTimetable(const ProblemSpec &problem, const CSRGraph &graph)
+{
+    Timetable timetable;
+
+    for (int mode = 1; mode <= 5; mode++)
+    {
+        if (!(problem.modes >> mode & 1) || !problem.runsEvery[mode])
+            continue;
+
+        // the mode's route as a simple undirected graph, zero length loops left out
+        std::vector<int> index(graph.vertices, -1), routeVertices;
+        std::vector<std::vector<int>> neighbours;
+        for (int v = 1; v < graph.vertices; v++)
+            for (int e = graph.offset[v]; e < graph.offset[v + 1]; e++)
+            {
+                int u = graph.target[e];
+                if (graph.mode[e] != mode || u == v)
+                    continue;
+                if (index[v] == -1)
+                {
+                    index[v] = neighbours.size();
+                    neighbours.emplace_back();
+                    routeVertices.push_back(v);
+                }
+                if (std::find(neighbours[index[v]].begin(), neighbours[index[v]].end(), u) == neighbours[index[v]].end())
+                    neighbours[index[v]].push_back(u);
+            }
+
+        // stretches from every end or branch, then what is left: routes that close into a loop
+        std::vector<std::vector<int>> paths;
+        std::vector<std::vector<char>> walked(neighbours.size());
+        for (size_t i = 0; i < neighbours.size(); i++)
+            walked[i].assign(neighbours[i].size(), 0);
+
+        for (int pass = 0; pass < 2; pass++)
+            for (int v : routeVertices)
+            {
+                const std::vector<int> &out = neighbours[index[v]];
+                if ((pass == 0) == (out.size() == 2))
+                    continue;
+                for (int k = 0; k < (int)out.size(); k++)
+                    if (!walked[index[v]][k])
+                        paths.push_back(traceLine(neighbours, index, v, out[k], walked));
+            }
+
+        double speed = problem.speed[mode];
+        int trips = (int)((SERVICE_END - SERVICE_START) / problem.runsEvery[mode]) + 1;
+
+        for (const std::vector<int> &path : paths)
+            for (int direction = 0; direction < 2; direction++)
+            {
+                TransitLine line;
+                line.mode = mode;
+                line.runsEvery = problem.runsEvery[mode];
+                line.stops = path;
+                if (direction)
+                    std::reverse(line.stops.begin(), line.stops.end());
+
+                line.offsets.push_back(0);
+                for (int i = 0; i + 1 < (int)line.stops.size(); i++)
+                {
+                    int e = transitSlot(graph, line.stops[i], line.stops[i + 1], mode);
+                    line.edges.push_back(e);
+                    line.offsets.push_back(line.offsets.back() + graph.length[e] / speed * 60.0);
+                }
+
+                line.firstTrip = timetable.tripStart.size();
+                line.trips = trips;
+                for (int k = 0; k < trips; k++)
+                {
+                    timetable.tripLine.push_back(timetable.lines.size());
+                    timetable.tripStart.push_back(SERVICE_START + k * problem.runsEvery[mode]);
+                }
+                timetable.lines.push_back(line);
+            }
+    }
+
+    for (const TransitLine &line : timetable.lines)
+        for (int trip = line.firstTrip; trip < line.firstTrip + line.trips; trip++)
+            for (int i = 0; i + 1 < (int)line.stops.size(); i++)
+                timetable.connections.push_back({line.stops[i], line.stops[i + 1], timetable.tripStart[trip] + line.offsets[i],
+                                                 timetable.tripStart[trip] + line.offsets[i + 1], trip, i, line.edges[i]});
+
+    timetable.stopOf.assign(graph.vertices, -1);
+    for (int l = 0; l < (int)timetable.lines.size(); l++)
+        for (int i = 0; i < (int)timetable.lines[l].stops.size(); i++)
+        {
+            int v = timetable.lines[l].stops[i];
+            if (timetable.stopOf[v] == -1)
+            {
+                timetable.stopOf[v] = timetable.stopVertex.size();
+                timetable.stopVertex.push_back(v);
+                timetable.serving.emplace_back();
+            }
+            timetable.serving[timetable.stopOf[v]].push_back({l, i});
+        }
+
+    std::sort(timetable.connections.begin(), timetable.connections.end(), [](const TransitConnection &a, const TransitConnection &b) {
+        if (a.departure != b.departure)
+            return a.departure < b.departure;
+        if (a.arrival != b.arrival)
+            return a.arrival < b.arrival;
+        return a.trip != b.trip ? a.trip < b.trip : a.index < b.index;
+    });
+
+    return timetable;
+}
+
+// The problem's cost along the path to dst in `nodes`, for the timetable engines that search by arrival
+inline void writePathCosts(const ProblemSpec &problem, int dst, SearchContext &nodes, const QueryGraph &graph)
+{
+    int prev = -1;
+    for (int v : extractPath(nodes, dst))
+    {
+        if (problem.objective == MIN_ARRIVAL)
+            nodes[v].cost = nodes[v].arrivalTime;
+        else
+            nodes[v].cost = prev == -1 ? 0 : nodes[prev].cost + edgeWeight(problem, graph.length(nodes[v].prevEdge), graph.mode(nodes[v].prevEdge));
+        prev = v;
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/*
+    Runs task(worker, i) once for every i in 0 .. count-1 on `workers`
+    threads, for loops whose iterations differ a lot in cost.
+
+    Every worker starts with an even slice of the indices and takes them
+    from the front. A worker whose slice runs out steals the back half of
+    another worker's remaining slice, so a slice full of slow iterations is
+    shared out instead of keeping one thread busy long after the rest are
+    idle. A slice is one 64 bit word (next index, end) changed only by
+    compare-and-swap, so owner and thieves never lock.
+
+    `worker` is 0 .. workers-1, for state a worker keeps between tasks.
+    Tasks must not throw.
+*/
+class StealingRanges
+{
+public:
+    explicit StealingRanges(int count, int workers) : workers(workers), ranges(new std::atomic<uint64_t>[workers])
+    {
+        for (int w = 0; w < workers; w++)
+            ranges[w].store(pack((int64_t)count * w / workers, (int64_t)count * (w + 1) / workers));
+    }
+
+    // next index for `worker`, -1 once there is nothing left to take or steal
+    int next(int worker)
+    {
+        std::atomic<uint64_t> &own = ranges[worker];
+        uint64_t range = own.load();
+        while (begin(range) < end(range))
+            if (own.compare_exchange_weak(range, pack(begin(range) + 1, end(range))))
+                return begin(range);
+
+        for (int k = 1; k < workers; k++)
+        {
+            std::atomic<uint64_t> &victim = ranges[(worker + k) % workers];
+            uint64_t range = victim.load();
+            while (begin(range) < end(range))
+            {
+                int half = (end(range) - begin(range) + 1) / 2;
+                int from = end(range) - half;
+                if (victim.compare_exchange_weak(range, pack(begin(range), from)))
+                {
+                    // own slice is empty, thieves leave it alone until this store
+                    own.store(pack(from + 1, end(range)));
+                    return from;
+                }
+            }
+        }
+        return -1;
+    }
+
+private:
+    int workers;
+    std::unique_ptr<std::atomic<uint64_t>[]> ranges;
+
+    static uint64_t pack(uint32_t begin, uint32_t end)
+    {
+        return (uint64_t)begin << 32 | end;
+    }
+
+    static int begin(uint64_t range)
+    {
+        return range >> 32;
+    }
+
+    static int end(uint64_t range)
+    {
+        return (uint32_t)range;
+    }
+};
+
+// task(worker, i) for every i in 0 .. count-1 on `workers` threads (0: one per hardware thread), returns when all are done
+inline void forEachStealing(int count, int workers, const std::function<void(int, int)> &task)
+{
+    if (workers <= 0)
+        workers = ThreadPool::defaultThreads();
+
+    StealingRanges ranges(count, workers);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; w++)
+        threads.emplace_back([&, w] {
+            for (int i = ranges.next(w); i != -1; i = ranges.next(w))
+                task(w, i);
+        });
+
+    for (std::thread &thread : threads)
+        thread.join();
+}
@@ -0,0 +1,488 @@
+#include <cerrno>
+#include <cstdio>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../Graph/DhakaGraph.h"
+#include "../Graph/RouteQuery.h"
+#include "../Graph/ThreadPool.h"
+
+using namespace std;
+
+/*
+    Routing daemon. Loads the graph once and answers route queries from
+    local processes over a Unix domain socket.
+
+        cd "Route Server"
+        g++ -O2 -pthread Route-Server.cpp -o Route-Server
+        ./Route-Server [socket path] [worker threads]
+
+    Protocol, one request per line and one response line per request:
+
+        request:  id problem srcLon srcLat dstLon dstLat [startingTime] [scheduledTime]
+        response: id,problem,status,distance_km,cost_tk,departure,arrival,travel_minutes,legs
+
+    The request after the id is the Batch-Query line format (RouteQuery.h)
+    and the response is its CSV record, so any problem 1-6 can be asked. A
+    changes request is answered with its earliest alternative only. A point
+    more than MAX_SNAP_KM from the problem's network is an error, not a
+    walk across the country.
+
+        request:  id fares problem walk car metro uttaraBus bikolpoBus
+        response: id,problem,fares updated,,,,,,
+
+    changes the Tk per km of Problem 2 or 3 for every later request. The
+    new costs are customized on the snapshot's customizable hierarchy
+    (Customizable.h) in the background, in well under a second; requests
+    until then keep the old fares.
+    `id` is any token chosen by the client and echoed back. A client may
+    send many requests without waiting; they are answered in parallel, so
+    responses can come back in a different order than the requests.
+
+        printf '1 5 90.363824 23.834127 90.375864 23.723166 05:43pm\n' | socat - UNIX-CONNECT:/tmp/dhaka-route.sock
+
+    One thread runs an epoll loop over the listening socket and every
+    connection, reading requests and writing responses without blocking.
+    Searches run on a worker pool, each worker thread with its own
+    RouteSolver; finished responses are handed back to the loop through an
+    eventfd. SIGINT / SIGTERM shut the server down and remove the socket.
+*/
+
+const size_t MAX_REQUEST_LINE = 4096;
+
+// farthest a request's point may be from the nearest vertex of the problem's modes
+const double MAX_SNAP_KM = 10;
+
+// epoll keys below FIRST_CONNECTION are not connections
+const uint64_t LISTENER = 0;
+const uint64_t WAKEUP = 1;
+const uint64_t SIGNALS = 2;
+const uint64_t FIRST_CONNECTION = 3;
+
+struct Connection
+{
+    int fd;
+    string in;
+    string out;
+    int pending = 0;          // requests handed to the workers and not answered yet
+    bool readClosed = false;  // peer finished sending, or sent garbage
+    bool watchingOut = false; // EPOLLOUT is registered
+};
+
+struct Response
+{
+    uint64_t connection;
+    string record;
+};
+
+class RouteServer
+{
+public:
+    RouteServer(const CSRGraph &graph, int threads)
+        : graph(graph), workers(threads), customizer(threads), metrics(make_shared<MetricSet>())
+    {
+        if (!graph.customizable)
+            return;
+
+        for (int number = 1; number <= PROBLEMS; number++)
+            if (!problemSpec(number).timed)
+                metrics = metrics->with(problemSpec(number), graph, customizer);
+    }
+
+    bool listenOn(const string &path)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            cerr << "Socket path is too long - " << path << endl;
+            return false;
+        }
+        strcpy(address.sun_path, path.c_str());
+
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(path.c_str()); // a socket left behind by an earlier run
+
+        if (listener < 0 || ::bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 128) != 0)
+        {
+            cerr << "Cant listen on " << path << " - " << strerror(errno) << endl;
+            return false;
+        }
+        socketPath = path;
+
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigprocmask(SIG_BLOCK, &signals, nullptr);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+        watch(listener, LISTENER, EPOLLIN);
+        watch(wakeFd, WAKEUP, EPOLLIN);
+        watch(signalFd, SIGNALS, EPOLLIN);
+        return true;
+    }
+
+    ~RouteServer()
+    {
+        for (auto &entry : connections)
+            close(entry.second.fd);
+        for (int fd : {listener, wakeFd, signalFd, epollFd})
+            if (fd >= 0)
+                close(fd);
+        if (!socketPath.empty())
+            unlink(socketPath.c_str());
+    }
+
+    void run()
+    {
+        const int MAX_EVENTS = 64;
+        epoll_event events[MAX_EVENTS];
+
+        while (!stopping)
+        {
+            int count = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+            if (count < 0 && errno != EINTR)
+            {
+                cerr << "epoll_wait failed - " << strerror(errno) << endl;
+                return;
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                uint64_t key = events[i].data.u64;
+
+                if (key == LISTENER)
+                    acceptConnections();
+                else if (key == WAKEUP)
+                    deliverResponses();
+                else if (key == SIGNALS)
+                    stopping = true;
+                else
+                {
+                    auto it = connections.find(key);
+                    if (it == connections.end())
+                        continue;
+
+                    if (events[i].events & (EPOLLHUP | EPOLLERR))
+                        drop(key); // gone both ways, nobody left to answer
+                    else
+                    {
+                        if (events[i].events & EPOLLIN)
+                            readRequests(key, it->second);
+                        if (events[i].events & EPOLLOUT)
+                            flush(key);
+                    }
+                }
+            }
+        }
+
+        // let the searches already running finish before the graph goes away
+        workers.wait();
+    }
+
+private:
+    const CSRGraph &graph;
+    ThreadPool workers;
+    ThreadPool customizer; // customize() runs here, a worker waiting on its own pool would never finish
+
+    mutex metricsMutex;
+    shared_ptr<const MetricSet> metrics; // replaced whole by every fare update
+    mutex customizeMutex;                // one fare update at a time, so none is lost
+
+    int listener = -1;
+    int wakeFd = -1;
+    int signalFd = -1;
+    int epollFd = -1;
+    string socketPath;
+    bool stopping = false;
+
+    unordered_map<uint64_t, Connection> connections;
+    uint64_t nextConnection = FIRST_CONNECTION;
+
+    mutex responsesMutex;
+    vector<Response> responses; // finished by the workers, not yet queued on their connection
+
+    shared_ptr<const MetricSet> currentMetrics()
+    {
+        lock_guard<mutex> lock(metricsMutex);
+        return metrics;
+    }
+
+    // whether both points of `query` are within MAX_SNAP_KM of the problem's network
+    bool nearNetwork(const RouteQuery &query, string &error) const
+    {
+        unsigned modes = problemSpec(query.problem).modes;
+        for (const pair<double, double> &lonLat : {query.src_lonLat, query.dst_lonLat})
+        {
+            double distance;
+            if (graph.nearestVertex(lonLat, modes, -1, distance) == -1 || distance > MAX_SNAP_KM)
+            {
+                char number[64];
+                snprintf(number, sizeof(number), "%g", MAX_SNAP_KM);
+                error = string(lonLat == query.src_lonLat ? "source" : "destination") + " is more than " + number + " km from the network";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    string updateFares(const string &id, const string &request)
+    {
+        istringstream in(request);
+        string command, rest;
+        int number = 0;
+        in >> command >> number;
+
+        if (number < 1 || number > PROBLEMS || problemSpec(number).timed || problemSpec(number).objective != MIN_COST)
+            return formatResultCSV(id, RouteQuery(), RouteResult(), "fares are for Problems 2 and 3");
+
+        ProblemSpec problem = problemSpec(number);
+        for (int mode = 1; mode <= 5; mode++)
+            if (!(in >> problem.costPerKM[mode]) || !(problem.costPerKM[mode] >= 0) || problem.costPerKM[mode] == numeric_limits<double>::infinity())
+                return formatResultCSV(id, RouteQuery(), RouteResult(), "expected five Tk per km, walk car metro uttaraBus bikolpoBus");
+        if (in >> rest)
+            return formatResultCSV(id, RouteQuery(), RouteResult(), "unexpected " + rest);
+
+        if (!graph.customizable)
+            return formatResultCSV(id, RouteQuery(), RouteResult(), "the snapshot has no customizable hierarchy, run Graph-Compile");
+
+        lock_guard<mutex> customizing(customizeMutex);
+        shared_ptr<const MetricSet> updated = currentMetrics()->with(problem, graph, customizer);
+        {
+            lock_guard<mutex> lock(metricsMutex);
+            metrics = updated;
+        }
+
+        return csvField(id) + "," + to_string(number) + ",fares updated,,,,,,";
+    }
+
+    void watch(int fd, uint64_t key, uint32_t events, int operation = EPOLL_CTL_ADD)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = key;
+        epoll_ctl(epollFd, operation, fd, &event);
+    }
+
+    void acceptConnections()
+    {
+        while (true)
+        {
+            int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                return; // EAGAIN: accepted everything that was waiting
+
+            uint64_t key = nextConnection++;
+            connections[key].fd = fd;
+            watch(fd, key, EPOLLIN | EPOLLRDHUP);
+        }
+    }
+
+    void readRequests(uint64_t key, Connection &connection)
+    {
+        char buffer[65536];
+
+        while (!connection.readClosed)
+        {
+            ssize_t got = read(connection.fd, buffer, sizeof(buffer));
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0 && errno == EAGAIN)
+                break;
+            if (got <= 0)
+            {
+                connection.readClosed = true;
+                break;
+            }
+
+            connection.in.append(buffer, got);
+
+            size_t start = 0, newline;
+            while ((newline = connection.in.find('\n', start)) != string::npos)
+            {
+                submit(key, connection, connection.in.substr(start, newline - start));
+                start = newline + 1;
+            }
+            connection.in.erase(0, start);
+
+            if (connection.in.size() > MAX_REQUEST_LINE)
+            {
+                connection.out += formatResultCSV("", RouteQuery(), RouteResult(), "request line too long") + '\n';
+                connection.readClosed = true;
+            }
+        }
+
+        if (connection.readClosed)
+        {
+            // a last request without its newline
+            if (!connection.in.empty() && connection.in.size() <= MAX_REQUEST_LINE)
+                submit(key, connection, connection.in);
+            connection.in.clear();
+
+            watch(connection.fd, key, connection.watchingOut ? (uint32_t)EPOLLOUT : 0, EPOLL_CTL_MOD);
+        }
+
+        flush(key);
+    }
+
+    void submit(uint64_t key, Connection &connection, string line)
+    {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == string::npos)
+            return;
+
+        size_t idEnd = line.find_first_of(" \t\r", first);
+        string id = line.substr(first, idEnd == string::npos ? string::npos : idEnd - first);
+        string request = idEnd == string::npos ? "" : line.substr(idEnd);
+
+        string command;
+        istringstream(request) >> command;
+
+        connection.pending++;
+        workers.submit([this, key, id, request, command] {
+            string record;
+            if (command == "fares")
+                record = updateFares(id, request);
+            else
+            {
+                // one solver per worker thread, kept for the life of the thread
+                static thread_local unique_ptr<RouteSolver> solver;
+                if (!solver)
+                    solver.reset(new RouteSolver(graph));
+
+                RouteQuery query;
+                RouteResult result;
+                string error;
+
+                if (parseRouteQuery(request, query, error) && nearNetwork(query, error))
+                    result = solver->solve(query, currentMetrics().get());
+
+                record = formatResultCSV(id, query, result, error);
+            }
+
+            {
+                lock_guard<mutex> lock(responsesMutex);
+                responses.push_back({key, move(record)});
+            }
+
+            uint64_t one = 1;
+            ssize_t ignored = write(wakeFd, &one, sizeof(one));
+            (void)ignored;
+        });
+    }
+
+    void deliverResponses()
+    {
+        uint64_t wakeups;
+        ssize_t ignored = read(wakeFd, &wakeups, sizeof(wakeups));
+        (void)ignored;
+
+        vector<Response> finished;
+        {
+            lock_guard<mutex> lock(responsesMutex);
+            finished.swap(responses);
+        }
+
+        for (Response &response : finished)
+        {
+            auto it = connections.find(response.connection);
+            if (it == connections.end())
+                continue; // the client went away meanwhile
+
+            it->second.pending--;
+            it->second.out += response.record;
+            it->second.out += '\n';
+        }
+
+        for (Response &response : finished)
+            flush(response.connection);
+    }
+
+    // writes what the socket takes, closes the connection once it has nothing left to do
+    void flush(uint64_t key)
+    {
+        auto it = connections.find(key);
+        if (it == connections.end())
+            return;
+        Connection &connection = it->second;
+
+        size_t written = 0;
+        while (written < connection.out.size())
+        {
+            ssize_t sent = send(connection.fd, connection.out.data() + written, connection.out.size() - written, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && errno == EAGAIN)
+                break;
+            if (sent < 0)
+            {
+                drop(key);
+                return;
+            }
+            written += sent;
+        }
+        connection.out.erase(0, written);
+
+        if (connection.readClosed && connection.pending == 0 && connection.out.empty())
+        {
+            drop(key);
+            return;
+        }
+
+        bool wantOut = !connection.out.empty();
+        if (wantOut != connection.watchingOut)
+        {
+            connection.watchingOut = wantOut;
+            uint32_t events = (connection.readClosed ? 0 : EPOLLIN | EPOLLRDHUP) | (wantOut ? (uint32_t)EPOLLOUT : 0);
+            watch(connection.fd, key, events, EPOLL_CTL_MOD);
+        }
+    }
+
+    void drop(uint64_t key)
+    {
+        auto it = connections.find(key);
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        connections.erase(it);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    string socketPath = argc > 1 ? argv[1] : "/tmp/dhaka-route.sock";
+    int threads = argc > 2 ? atoi(argv[2]) : 0;
+
+    CSRGraph graph;
+    if (!loadDhakaGraph(graph))
+        return 1;
+
+    RouteServer server(graph, threads);
+    if (!server.listenOn(socketPath))
+        return 1;
+
+    cerr << "Serving " << graph.vertexCount() - 1 << " vertices on " << socketPath << endl;
+    server.run();
+    cerr << "Stopped" << endl;
+
+    return 0;
+}